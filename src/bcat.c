@@ -4,7 +4,7 @@
 #include "write_simple.h"
 
 #define DESCRIPTION "cat some bsv files to csv\n\n"
-#define USAGE "bcat [-l|--lz4] [-p|--prefix] [-h N|--head N] FILE1 ... FILEN\n\n"
+#define USAGE "bcat [-l|--lz4] [-p|--prefix] [-h N|--head N] [-P N|--prefetch N] [-n|--no-verify] FILE1 ... FILEN\n\n"
 #define EXAMPLE                                     \
     ">> for char in a a b b c c; do\n"              \
     "     echo $char | bsv >> /tmp/$char\n"         \
@@ -26,12 +26,17 @@ int main(int argc, char **argv) {
     bool prefix = false;
     bool lz4 = false;
     i64 head = 0;
+    i32 prefetch = 0;
+    bool verify = true;
     ARGH_PARSE {
         ARGH_NEXT();
-        if      ARGH_BOOL("-p", "--prefix") { prefix = true; }
-        else if ARGH_BOOL("-l", "--lz4")    { lz4 = true; }
-        else if ARGH_FLAG("-h", "--head")   { ASSERT(isdigits(ARGH_VAL()), "fatal: should have been `--head INT`, not `--head %s`\n", ARGH_VAL());
-                                              head = atol(ARGH_VAL());}
+        if      ARGH_BOOL("-p", "--prefix")    { prefix = true; }
+        else if ARGH_BOOL("-l", "--lz4")       { lz4 = true; }
+        else if ARGH_FLAG("-h", "--head")      { ASSERT(isdigits(ARGH_VAL()), "fatal: should have been `--head INT`, not `--head %s`\n", ARGH_VAL());
+                                                 head = atol(ARGH_VAL());}
+        else if ARGH_FLAG("-P", "--prefetch")  { ASSERT(isdigits(ARGH_VAL()), "fatal: should have been `--prefetch INT`, not `--prefetch %s`\n", ARGH_VAL());
+                                                 prefetch = atol(ARGH_VAL()); }
+        else if ARGH_BOOL("-n", "--no-verify") { verify = false; }
     }
 
     // setup input
@@ -40,6 +45,9 @@ int main(int argc, char **argv) {
     for (i32 i = 0; i < ARGH_ARGC; i++)
         FOPEN(files[i], ARGH_ARGV[i], "rb");
     readbuf_t rbuf = rbuf_init(files, ARGH_ARGC, lz4);
+    rbuf.verify = verify; // ------------------------------------------------------ skip checksums for trusted input
+    if (prefetch)
+        rbuf_prefetch(&rbuf, prefetch);
     row_t row;
 
     // setup output
@@ -1,12 +1,21 @@
 #include "util.h"
+#include "argh.h"
 #include "load.h"
 #include "dump.h"
-#include "fastmap.h"
+#include "hashagg.h"
 
-#define DESCRIPTION "count as i64 by hash of the first column\n\n"
-#define USAGE "... | bcounteach-hash\n\n"
+#define DESCRIPTION "count as i64 by hash of the first column, spilling to disk past an optional memory limit\n\n"
+#define USAGE "... | bcounteach-hash [-m SIZE|--memory-limit SIZE] [-T DIR|--tmpdir DIR] [-j N|--jobs N]\n\n"
 #define EXAMPLE "echo '\na\na\nb\nb\nb\na\n' | bsv | bcounteach-hash | bschema *,i64:a | bsort | csv\na,3\nb,3\n"
 
+i64 one = 1;
+
+// every row counts as 1
+const void *count_value(row_t *row) {
+    (void)row;
+    return &one;
+}
+
 int main(int argc, char **argv) {
 
     // setup bsv
@@ -14,30 +23,40 @@ int main(int argc, char **argv) {
     readbuf_t rbuf = rbuf_init((FILE*[]){stdin}, 1, false);
     writebuf_t wbuf = wbuf_init((FILE*[]){stdout}, 1, false);
 
+    // parse args
+    i64 memory_limit = 0;
+    i32 jobs = 1;
+    char *tmpdir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    ARGH_PARSE {
+        ARGH_NEXT();
+        if      ARGH_FLAG("-m", "--memory-limit") { memory_limit = parse_size(ARGH_VAL());
+                                                    ASSERT(memory_limit > 0, "fatal: should have been `--memory-limit SIZE` like 512M, not `--memory-limit %s`\n", ARGH_VAL()); }
+        else if ARGH_FLAG("-T", "--tmpdir")       { tmpdir = ARGH_VAL(); }
+        else if ARGH_FLAG("-j", "--jobs")         { ASSERT(isdigits(ARGH_VAL()) && atol(ARGH_VAL()) > 0, "fatal: should have been `--jobs INT`, not `--jobs %s`\n", ARGH_VAL());
+                                                    jobs = atol(ARGH_VAL()); }
+    }
+    ASSERT(jobs == 1 || !memory_limit, "fatal: --memory-limit is not supported with --jobs\n");
+    ASSERT(ARGH_ARGC == 0, "usage: %s", USAGE);
+
+    // with jobs, count on worker threads
+    if (jobs > 1) {
+        hashagg_parallel(I64, count_value, jobs, &rbuf);
+        return 0;
+    }
+
     // setup state
     row_t row;
-
-    FASTMAP_INIT(counts, i64, 1<<16);
+    hashagg_t counts = hashagg_init(I64, memory_limit, tmpdir, 0);
 
     while (1) {
         load_next(&rbuf, &row, 0);
         if (row.stop) {
             break;
         }
-        FASTMAP_SET_INDEX(counts, row.columns[0], row.sizes[0], i64);
-        FASTMAP_VALUE(counts)++;
+        hashagg_add(&counts, row.columns[0], row.sizes[0], count_value(&row));
     }
 
-    for (i32 i = 0; i < FASTMAP_SIZE(counts); i++) {
-        if (FASTMAP_KEYS(counts)[i] != NULL) {
-            row.max = 1;
-            row.columns[0] = FASTMAP_KEYS(counts)[i];
-            row.sizes[0] = FASTMAP_SIZES(counts)[i];
-            row.columns[1] = &FASTMAP_VALUES(counts)[i];
-            row.sizes[1] = sizeof(i64);
-            dump(&wbuf, &row, 0);
-        }
-    }
+    hashagg_finish(&counts, &wbuf);
     dump_flush(&wbuf, 0);
 
 }
@@ -0,0 +1,50 @@
+#include "util.h"
+#include "argh.h"
+#include "read.h"
+#include "write.h"
+
+#define DESCRIPTION "build the chunk index of a sorted bsv file for bdropuntil and btakeuntil\n\n"
+#define USAGE "bindex FILE [INDEX] [-l|--lz4]\n\n"
+#define EXAMPLE                                                                 \
+    ">> echo '\na\nb\nc\nd\n' | bsv | bsort > /tmp/data\n\n"                  \
+    ">> bindex /tmp/data /tmp/data.idx\n\n"                                     \
+    ">> bdropuntil c --index /tmp/data.idx < /tmp/data | csv\nc\nd\n"
+
+int main(int argc, char **argv) {
+
+    // setup bsv
+    SETUP();
+
+    // parse args
+    bool lz4 = false;
+    ARGH_PARSE {
+        ARGH_NEXT();
+        if ARGH_BOOL("-l", "--lz4") { lz4 = true; }
+    }
+    ASSERT(ARGH_ARGC == 1 || ARGH_ARGC == 2, "usage: %s", USAGE);
+    u8 path[1024];
+    if (ARGH_ARGC == 2)
+        SNPRINTF(path, sizeof(path), "%s", ARGH_ARGV[1]);
+    else
+        SNPRINTF(path, sizeof(path), "%s.idx", ARGH_ARGV[0]);
+
+    // setup input
+    FILE *file;
+    FOPEN(file, ARGH_ARGV[0], "rb");
+    readbuf_t rbuf = rbuf_init((FILE*[]){file}, 1, lz4);
+
+    // setup output
+    writebuf_t *index = index_open(path);
+
+    // read chunk by chunk, noting where each one starts
+    i64 offset;
+    i32 size;
+    while (1) {
+        offset = rbuf.mmaps[0] ? rbuf.mmap_offset[0] : ftello(file);
+        size = read_chunk(&rbuf, &rbuf.buffers[0], rbuf.codec_buf, 0);
+        if (size == -1)
+            break;
+        index_chunk(index, offset, rbuf.buffers[0], size);
+    }
+    index_flush(index);
+}
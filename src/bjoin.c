@@ -0,0 +1,173 @@
+#include "util.h"
+#include "argh.h"
+#include "load.h"
+#include "dump.h"
+#include "keys.h"
+
+#define DESCRIPTION "join two files sorted by the first column, with an inner, left or anti join\n\n"
+#define USAGE "bjoin [TYPE] [-r|--reversed] [-l|--lz4] [-L|--left] [-a|--anti] [-T DIR|--tmpdir DIR] LEFT RIGHT\n\n"
+#define EXAMPLE                                         \
+    ">> echo -e 'a,1\nb,2\nc,3\n' | bsv > left.bsv\n"   \
+    ">> echo -e 'a,x\nc,y\nc,z\n' | bsv > right.bsv\n"  \
+    ">> bjoin left.bsv right.bsv | csv\n"               \
+    "a,1,x\nc,3,y\nc,3,z\n"
+
+//
+// both inputs are read a row at a time, advancing whichever is behind.
+// a joined row is the key, the rest of the left row, and the rest of
+// the right row. when the keys match, the whole run of right rows with
+// that key is kept, so every left row with the key can be joined to
+// all of them. a run is held in a buffer of BUFFER_SIZE, and a run too
+// big for it spills to an unlinked temp file in the tmpdir a buffer at
+// a time, so memory stays constant however many rows share a key.
+//
+// left joins also write left rows that match nothing, as they are, and
+// anti joins only write those.
+//
+
+#define JOIN_INNER 0
+#define JOIN_LEFT 1
+#define JOIN_ANTI 2
+
+typedef struct run_s {
+    u8 *key; // ---------------------------------- first column of the right rows in the run
+    i32 key_size;
+    i32 key_capacity;
+    u8 *buffer; // ------------------------------- rows as laid out by dump()
+    i32 size;
+    u8 *spill_buffer;
+    FILE *spill; // ------------------------------ buffers written so far, each preceded by its i32 size
+    i64 spill_size; // --------------------------- bytes of the spill that belong to this run
+    bool spilled;
+} run_t;
+
+// start a new run of rows with the first column of row
+void run_reset(run_t *run, row_t *row) {
+    if (row->sizes[0] + 1 > run->key_capacity) {
+        run->key_capacity = row->sizes[0] + 1;
+        REALLOC(run->key, run->key_capacity);
+    }
+    memcpy(run->key, row->columns[0], row->sizes[0] + 1); // +1 for the trailing \0
+    run->key_size = row->sizes[0];
+    run->size = 0;
+    run->spill_size = 0;
+    run->spilled = false;
+}
+
+void run_add(run_t *run, row_t *row, char *tmpdir) {
+    raw_row_t raw_row;
+    row_to_raw(row, &raw_row);
+    i32 size = raw_row.header_size + raw_row.buffer_size;
+    if (run->size + size > BUFFER_SIZE) { // ---------------------------------------------------------- the run no longer fits, so spill what is buffered
+        if (!run->spill) {
+            run->spill = temp_open(tmpdir, "bjoin");
+            MALLOC(run->spill_buffer, BUFFER_SIZE);
+        }
+        ASSERT(0 == fseeko(run->spill, run->spill_size, SEEK_SET), "fatal: failed to seek temp file\n");
+        FWRITE(&run->size, sizeof(i32), run->spill);
+        FWRITE(run->buffer, run->size, run->spill);
+        run->spill_size += sizeof(i32) + run->size;
+        run->spilled = true;
+        run->size = 0;
+    }
+    memcpy(run->buffer + run->size, raw_row.header, size); // --------------------------------------- the header sits right before the columns
+    run->size += size;
+}
+
+// load the next row of file, checking its key
+inlined void join_next(readbuf_t *rbuf, row_t *row, i32 file, i32 value_type) {
+    load_next(rbuf, row, file);
+    if (!row->stop)
+        ASSERT_SIZE(value_type, row->sizes[0]);
+}
+
+// write left joined to every row of the run, the spilled ones first
+void run_join(writebuf_t *wbuf, run_t *run, row_t *left) {
+    row_t right;
+    i32 size;
+    i32 offset;
+    i64 position = 0;
+    if (run->spilled) {
+        ASSERT(0 == fseeko(run->spill, 0, SEEK_SET), "fatal: failed to rewind temp file\n");
+        while (position < run->spill_size) { // ------------------------------------------------------------ the file may be longer, left over from an earlier and bigger run
+            FREAD(&size, sizeof(i32), run->spill);
+            FREAD(run->spill_buffer, size, run->spill);
+            for (offset = 0; offset < size; ) {
+                offset += row_from_raw(run->spill_buffer + offset, &right);
+                dump_join(wbuf, left, &right, 0);
+            }
+            position += sizeof(i32) + size;
+        }
+    }
+    for (offset = 0; offset < run->size; ) {
+        offset += row_from_raw(run->buffer + offset, &right);
+        dump_join(wbuf, left, &right, 0);
+    }
+}
+
+int main(int argc, char **argv) {
+
+    // setup bsv
+    SETUP();
+
+    // parse args
+    bool reversed = false;
+    bool lz4 = false;
+    i32 join = JOIN_INNER;
+    char *tmpdir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    ARGH_PARSE {
+        ARGH_NEXT();
+        if      ARGH_BOOL("-r", "--reversed") { reversed = true; }
+        else if ARGH_BOOL("-l", "--lz4")      { lz4 = true; }
+        else if ARGH_BOOL("-L", "--left")     { join = JOIN_LEFT; }
+        else if ARGH_BOOL("-a", "--anti")     { join = JOIN_ANTI; }
+        else if ARGH_FLAG("-T", "--tmpdir")   { tmpdir = ARGH_VAL(); }
+    }
+    ASSERT(ARGH_ARGC == 2 || ARGH_ARGC == 3, "usage: %s", USAGE);
+    i32 value_type = ARGH_ARGC == 3 ? keys_type(ARGH_ARGV[0]) : STR;
+    if (reversed)
+        value_type += R_STR;
+    compare_fn_t cmp = compare_fn(value_type);
+
+    // setup input and output
+    FILE *files[2];
+    FOPEN(files[0], ARGH_ARGV[ARGH_ARGC - 2], "rb");
+    FOPEN(files[1], ARGH_ARGV[ARGH_ARGC - 1], "rb");
+    readbuf_t rbuf = rbuf_init(files, 2, lz4);
+    writebuf_t wbuf = wbuf_init((FILE*[]){stdout}, 1, false);
+
+    // setup state
+    row_t left;
+    row_t right;
+    run_t run = {0};
+    MALLOC(run.buffer, BUFFER_SIZE);
+    i32 order;
+
+    // process input row by row, the rows of each file stay valid while the other is read
+    join_next(&rbuf, &left, 0, value_type);
+    join_next(&rbuf, &right, 1, value_type);
+    while (!left.stop) {
+        while (!right.stop && cmp(right.columns[0], left.columns[0]) < 0) { // ------------------------------- catch right up to left
+            join_next(&rbuf, &right, 1, value_type);
+        }
+        order = right.stop ? 1 : cmp(right.columns[0], left.columns[0]);
+        if (order > 0) { // ------------------------------------------------------------------------------------ left matches nothing
+            if (join != JOIN_INNER)
+                dump(&wbuf, &left, 0);
+        } else { // -------------------------------------------------------------------------------------------- keep the run of right rows with this key
+            run_reset(&run, &right);
+            while (!right.stop && cmp(right.columns[0], run.key) == 0) {
+                run_add(&run, &right, tmpdir);
+                join_next(&rbuf, &right, 1, value_type);
+            }
+            while (!left.stop && cmp(left.columns[0], run.key) == 0) { // ----------------------------------- join every left row with this key to it
+                if (join != JOIN_ANTI)
+                    run_join(&wbuf, &run, &left);
+                join_next(&rbuf, &left, 0, value_type);
+            }
+            continue;
+        }
+        join_next(&rbuf, &left, 0, value_type);
+    }
+    dump_flush(&wbuf, 0);
+}
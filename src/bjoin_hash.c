@@ -0,0 +1,125 @@
+#include "util.h"
+#include "argh.h"
+#include "load.h"
+#include "dump.h"
+#include "arena.h"
+#include "fastmap.h"
+
+#define DESCRIPTION "join rows by hash of the first column against a small file held in memory, with an inner, left or anti join\n\n"
+#define USAGE "... | bjoin-hash [-l|--lz4] [-L|--left] [-a|--anti] [-m SIZE|--memory-limit SIZE] SMALLFILE\n\n"
+#define EXAMPLE                                         \
+    ">> echo -e 'a,x\nc,y\nc,z\n' | bsv > small.bsv\n"  \
+    ">> echo -e 'c,3\nb,2\na,1\n' | bsv | bjoin-hash small.bsv | csv\n" \
+    "c,3,y\nc,3,z\na,1,x\n"
+
+//
+// the small file is loaded into a fastmap by its first column, and its
+// rows are copied into an arena, chained in file order under their key.
+// rows from stdin are then joined to every small row with their first
+// column, in the order they come, as bjoin would join them with stdin
+// on the left. nothing is sorted, so the output is in the order of
+// stdin. the small file must fit in memory, and with --memory-limit
+// bjoin-hash fails as soon as it does not.
+//
+// the limit counts the map, its key buffers and the arena blocks, so it
+// can never be less than one of each, JOIN_MIN_MEMORY, with the map
+// starting small.
+//
+
+#define JOIN_INNER 0
+#define JOIN_LEFT 1
+#define JOIN_ANTI 2
+
+#define JOIN_INITIAL_SIZE (1 << 16)
+#define JOIN_INITIAL_SIZE_LIMITED (1 << 10)
+#define JOIN_SLOT_SIZE (sizeof(u8*) + sizeof(u16) + sizeof(entry_t*))
+#define JOIN_MIN_MEMORY (i64)(ARENA_BLOCK_SIZE + FASTMAP_KEY_BUF_SIZE + JOIN_INITIAL_SIZE_LIMITED * JOIN_SLOT_SIZE)
+
+typedef struct entry_s entry_t;
+struct entry_s {
+    entry_t *next;
+    entry_t *last; // ---------------------------- the end of the chain, only kept by its first entry
+    u8 row[]; // --------------------------------- as laid out by dump()
+};
+
+int main(int argc, char **argv) {
+
+    // setup bsv
+    SETUP();
+
+    // parse args
+    bool lz4 = false;
+    i32 join = JOIN_INNER;
+    i64 memory_limit = 0;
+    ARGH_PARSE {
+        ARGH_NEXT();
+        if      ARGH_BOOL("-l", "--lz4")          { lz4 = true; }
+        else if ARGH_BOOL("-L", "--left")         { join = JOIN_LEFT; }
+        else if ARGH_BOOL("-a", "--anti")         { join = JOIN_ANTI; }
+        else if ARGH_FLAG("-m", "--memory-limit") { memory_limit = parse_size(ARGH_VAL());
+                                                    ASSERT(memory_limit > 0, "fatal: should have been `--memory-limit SIZE` like 512M, not `--memory-limit %s`\n", ARGH_VAL()); }
+    }
+    ASSERT(ARGH_ARGC == 1, "usage: %s", USAGE);
+    ASSERT(!memory_limit || memory_limit >= JOIN_MIN_MEMORY, "fatal: --memory-limit must be at least %ld bytes\n", JOIN_MIN_MEMORY);
+
+    // setup input and output
+    FILE *file;
+    FOPEN(file, ARGH_ARGV[0], "rb");
+    readbuf_t rbuf = rbuf_init((FILE*[]){stdin, file}, 2, lz4);
+    writebuf_t wbuf = wbuf_init((FILE*[]){stdout}, 1, false);
+
+    // setup state
+    row_t row;
+    row_t small;
+    raw_row_t raw_row;
+    entry_t *entry;
+    i32 size;
+    i64 memory;
+    arena_t arena = arena_init();
+    FASTMAP_INIT(rows, entry_t*, memory_limit ? JOIN_INITIAL_SIZE_LIMITED : JOIN_INITIAL_SIZE);
+
+    // load the small file
+    while (1) {
+        load_next(&rbuf, &row, 1);
+        if (row.stop)
+            break;
+        row_to_raw(&row, &raw_row);
+        size = raw_row.header_size + raw_row.buffer_size;
+        entry = arena_alloc(&arena, sizeof(entry_t) + size);
+        entry->next = NULL;
+        memcpy(entry->row, raw_row.header, size); // ----------------------------------------------- the header sits right before the columns
+        FASTMAP_SET_INDEX(rows, row.columns[0], row.sizes[0], entry_t*);
+        if (FASTMAP_VALUE(rows) == NULL) {
+            entry->last = entry;
+            FASTMAP_VALUE(rows) = entry;
+        } else {
+            FASTMAP_VALUE(rows)->last->next = entry;
+            FASTMAP_VALUE(rows)->last = entry;
+        }
+        if (memory_limit) {
+            memory = (i64)arena.num_blocks * ARENA_BLOCK_SIZE
+                + FASTMAP_SIZE(rows) * JOIN_SLOT_SIZE
+                + (FASTMAP_KEY_BUF_SIZE) * (i64)(rows_keys_bufs_last_size + 1);
+            ASSERT(memory <= memory_limit, "fatal: %s needs more than --memory-limit %ld bytes, try bsort and bjoin instead\n", ARGH_ARGV[0], memory_limit);
+        }
+    }
+
+    // process stdin row by row
+    while (1) {
+        load_next(&rbuf, &row, 0);
+        if (row.stop)
+            break;
+        FASTMAP_FIND_INDEX(rows, row.columns[0], row.sizes[0]);
+        entry = FASTMAP_KEY(rows) ? FASTMAP_VALUE(rows) : NULL;
+        if (!entry) {
+            if (join != JOIN_INNER)
+                dump(&wbuf, &row, 0);
+        } else if (join != JOIN_ANTI) {
+            for (; entry; entry = entry->next) {
+                row_from_raw(entry->row, &small);
+                dump_join(&wbuf, &row, &small, 0);
+            }
+        }
+    }
+    dump_flush(&wbuf, 0);
+}
@@ -1,32 +1,67 @@
 #include "util.h"
-#include "lz4.h"
+#include "argh.h"
+#include "codec.h"
+#include "ordered.h"
 
-#define DESCRIPTION "compress bsv data\n\n"
-#define USAGE "... | blz4 \n\n"
-#define EXAMPLE ">> echo a,b,c | bsv | blz4 | blz4d | csv\na,b,c\n"
+#define DESCRIPTION "compress bsv data. CODEC is lz4, lz4hc or zstd, with an optional level like zstd:19, which for lz4 is an acceleration where higher is faster and compresses less\n\n"
+#define USAGE "... | blz4 [-j N|--jobs N] [-c CODEC|--codec CODEC] [-x|--checksum]\n\n"
+#define EXAMPLE ">> echo a,b,c | bsv | blz4 -c zstd:19 | blz4d | csv\na,b,c\n"
+
+i32 codec = CODEC_LZ4;
+bool checksum = false;
+
+void compress_chunk(ordered_chunk_t *chunk) {
+    u64 stats_hash = chunk->stats_size ? XXH3_64bits(chunk->stats, chunk->stats_size) : 0;
+    if (chunk->header & CHUNK_CHECKSUM) // ----------------------------------------------------------- header is still the one read from the input here
+        ASSERT(chunk->checksum == chunk_checksum(chunk->header, stats_hash, chunk->in, chunk->size), "fatal: chunk checksum mismatch\n");
+    chunk->header = CHUNK_HEADER(chunk->size, codec) | (checksum ? CHUNK_CHECKSUM : 0) | (chunk->stats_size ? CHUNK_STATS : 0);
+    chunk->out_size = codec_compress(codec, chunk->in, chunk->out, chunk->size);
+    if (checksum)
+        chunk->checksum = chunk_checksum(chunk->header, stats_hash, chunk->out, chunk->out_size);
+}
+
+void write_chunk(ordered_chunk_t *chunk) {
+    FWRITE(&chunk->header, sizeof(i32), stdout);
+    FWRITE(chunk->stats, chunk->stats_size, stdout);
+    FWRITE(&chunk->out_size, sizeof(i32), stdout);
+    FWRITE(chunk->out, chunk->out_size, stdout);
+    if (checksum)
+        FWRITE(&chunk->checksum, sizeof(u64), stdout);
+}
 
 int main(int argc, char **argv) {
 
     // setup bsv
     SETUP();
 
+    // parse args
+    i32 jobs = 1;
+    ARGH_PARSE {
+        ARGH_NEXT();
+        if      ARGH_FLAG("-j", "--jobs")     { ASSERT(isdigits(ARGH_VAL()), "fatal: should have been `--jobs INT`, not `--jobs %s`\n", ARGH_VAL());
+                                                jobs = atol(ARGH_VAL()); }
+        else if ARGH_FLAG("-c", "--codec")    { codec = codec_parse(ARGH_VAL()); }
+        else if ARGH_BOOL("-x", "--checksum") { checksum = true; }
+    }
+    ASSERT(CODEC_TYPE(codec) != CODEC_NONE, "fatal: codec must compress, got: none\n");
+
     // setup state
-    i32 size;
-    i32 lz4_size;
-    u8 *buf;
-    MALLOC(buf, BUFFER_SIZE);
-    u8 *lz4_buf;
-    MALLOC(lz4_buf, BUFFER_SIZE_LZ4);
     ASSERT(LZ4_compressBound(BUFFER_SIZE) <= BUFFER_SIZE_LZ4, "fatal: lz4 compress bound\n");
+    ordered_t *o = ordered_init(jobs, BUFFER_SIZE, BUFFER_SIZE_LZ4, compress_chunk, write_chunk);
+    ordered_chunk_t *chunk;
 
-    // process input row by row
+    // read chunks in order, compress them on the workers, and write them in order
     while (1) {
-        if (0 == fread_unlocked(&size, 1, sizeof(i32), stdin))
+        chunk = ordered_next(o);
+        if (0 == fread_unlocked(&chunk->header, 1, sizeof(i32), stdin))
             break;
-        FREAD(buf, size, stdin);
-        lz4_size = LZ4_compress_fast(buf, lz4_buf, size, BUFFER_SIZE_LZ4, LZ4_ACCELERATION);
-        FWRITE(&size, sizeof(i32), stdout);
-        FWRITE(&lz4_size, sizeof(i32), stdout);
-        FWRITE(lz4_buf, lz4_size, stdout);
+        ASSERT(CHUNK_VALID(chunk->header) && CHUNK_CODEC(chunk->header) == CODEC_NONE, "fatal: bad chunk size, input must be plain bsv: %d\n", chunk->header);
+        chunk->size = CHUNK_SIZE(chunk->header);
+        chunk->stats_size = chunk->header & CHUNK_STATS ? stats_read(chunk->stats, stdin) : 0; // ------- stats describe the rows, so they carry over as they are
+        FREAD(chunk->in, chunk->size, stdin);
+        if (chunk->header & CHUNK_CHECKSUM) // ---------------------------------------------------------- verified on the worker, and only written again with --checksum
+            FREAD(&chunk->checksum, sizeof(u64), stdin);
+        ordered_submit(o);
     }
+    ordered_finish(o);
 }
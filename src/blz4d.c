@@ -1,33 +1,62 @@
 #include "util.h"
-#include "lz4.h"
+#include "argh.h"
+#include "codec.h"
+#include "ordered.h"
 
 #define DESCRIPTION "decompress bsv data\n\n"
-#define USAGE "... | blz4d \n\n"
+#define USAGE "... | blz4d [-j N|--jobs N]\n\n"
 #define EXAMPLE ">> echo a,b,c | bsv | blz4 | blz4d | csv\na,b,c\n"
 
+void decompress_chunk(ordered_chunk_t *chunk) {
+    i32 codec = CHUNK_CODEC(chunk->header);
+    if (codec == CODEC_NONE) // ---------------------------------------------------------------------- untagged chunks are legacy lz4
+        codec = CODEC_LZ4;
+    u64 stats_hash = chunk->stats_size ? XXH3_64bits(chunk->stats, chunk->stats_size) : 0;
+    if (chunk->header & CHUNK_CHECKSUM)
+        ASSERT(chunk->checksum == chunk_checksum(chunk->header, stats_hash, chunk->in, chunk->in_size), "fatal: chunk checksum mismatch\n");
+    codec_decompress(codec, chunk->in, chunk->in_size, chunk->out, chunk->size);
+}
+
+void write_chunk(ordered_chunk_t *chunk) {
+    i32 header = chunk->size | (chunk->stats_size ? CHUNK_STATS : 0);
+    FWRITE(&header, sizeof(i32), stdout);
+    FWRITE(chunk->stats, chunk->stats_size, stdout);
+    FWRITE(chunk->out, chunk->size, stdout);
+}
+
 int main(int argc, char **argv) {
 
     // setup bsv
     SETUP();
 
+    // parse args
+    i32 jobs = 1;
+    ARGH_PARSE {
+        ARGH_NEXT();
+        if ARGH_FLAG("-j", "--jobs") { ASSERT(isdigits(ARGH_VAL()), "fatal: should have been `--jobs INT`, not `--jobs %s`\n", ARGH_VAL());
+                                       jobs = atol(ARGH_VAL()); }
+    }
+
     // setup state
-    i32 size;
-    i32 lz4_size;
-    u8 *buf;
-    MALLOC(buf, BUFFER_SIZE);
-    u8 *lz4_buf;
-    MALLOC(lz4_buf, BUFFER_SIZE_LZ4);
     ASSERT(LZ4_compressBound(BUFFER_SIZE) <= BUFFER_SIZE_LZ4, "fatal: lz4 compress bound\n");
+    ordered_t *o = ordered_init(jobs, BUFFER_SIZE_LZ4, BUFFER_SIZE, decompress_chunk, write_chunk);
+    ordered_chunk_t *chunk;
 
-    // process input row by row
+    // read chunks in order, decompress them on the workers, and write them in order
     while (1) {
-        if (0 == fread_unlocked(&size, 1, sizeof(i32), stdin))
+        chunk = ordered_next(o);
+        if (0 == fread_unlocked(&chunk->header, 1, sizeof(i32), stdin))
             break;
-        FREAD(&lz4_size, sizeof(i32), stdin);
-        FREAD(lz4_buf, lz4_size, stdin);
-        ASSERT(size == LZ4_decompress_safe(lz4_buf, buf, lz4_size, BUFFER_SIZE), "fatal: decompress size mismatch\n");
-        FWRITE(&size, sizeof(i32), stdout);
-        FWRITE(buf, size, stdout);
+        ASSERT(CHUNK_VALID(chunk->header), "fatal: bad chunk size: %d\n", chunk->header);
+        chunk->size = CHUNK_SIZE(chunk->header);
+        chunk->stats_size = chunk->header & CHUNK_STATS ? stats_read(chunk->stats, stdin) : 0;
+        FREAD(&chunk->in_size, sizeof(i32), stdin);
+        ASSERT(0 <= chunk->in_size && chunk->in_size <= BUFFER_SIZE_LZ4, "fatal: bad compressed chunk size: %d\n", chunk->in_size);
+        FREAD(chunk->in, chunk->in_size, stdin);
+        if (chunk->header & CHUNK_CHECKSUM)
+            FREAD(&chunk->checksum, sizeof(u64), stdin);
+        ordered_submit(o);
     }
+    ordered_finish(o);
 
 }
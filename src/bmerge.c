@@ -1,34 +1,402 @@
 #include "util.h"
 #include "argh.h"
-#include "heap.h"
+#include "losertree.h"
 #include "array.h"
 #include "load.h"
 #include "dump.h"
+#include "keys.h"
+#include "thread.h"
+#include "arena.h"
+#include "index.h"
 
-#define DESCRIPTION "merge sorted files from stdin\n\n"
-#define USAGE "echo FILE1 ... FILEN | bmerge [TYPE] [-r|--reversed] [-l|--lz4]\n\n"
+#define DESCRIPTION "merge sorted files from stdin, by the first column or by a key like 1:i64,3:str,-2:f64 as given to bsort, optionally folding rows with identical first columns like bsumeach, bcounteach or bdedupe\n\n"
+#define USAGE "echo FILE1 ... FILEN | bmerge [TYPE|KEY] [-r|--reversed] [-l|--lz4] [-P N|--prefetch N] [-n|--no-verify] [-i INDEX|--index INDEX] [-s|--stats] [-S TYPE|--sum TYPE] [-c|--count] [-d|--dedupe] [-j N|--jobs N] [-T DIR|--tmpdir DIR]\n\n"
 #define EXAMPLE                                 \
     ">> echo -e 'a\nc\ne\n' | bsv > a.bsv\n"    \
     ">> echo -e 'b\nd\nf\n' | bsv > b.bsv\n"    \
     ">> echo a.bsv b.bsv | bmerge\n"            \
     "a\nb\nc\nd\ne\nf\n"                        \
 
+
+//
+// with --jobs, the key space is cut into one range per job and the
+// ranges are merged concurrently, each by a worker that reads every
+// input but only the rows of its range. the ranges are cut at splitter
+// rows, which are picked evenly from the first rows of chunks sampled
+// from every input, at most SAMPLES_PER_JOB per job and input. a sample
+// also records which chunk it starts, so a worker starts each input at
+// its last sample before the range instead of at the beginning.
+//
+// sampling reads as little as it can. when the key is the first column,
+// the first keys come from the index at FILE.idx as written by bindex,
+// or from the chunk stats, and no chunk is decompressed. otherwise the
+// first row of each sampled chunk is read, and the chunks between
+// samples are passed over with read_skip().
+//
+// the first worker writes straight to stdout, the rest to unlinked temp
+// files in the tmpdir, which are appended to stdout in order once every
+// worker is done. rows that compare equal are always in the same range,
+// so the output is exactly what a single merge would produce.
+//
+
+#define SAMPLES_PER_JOB 8
+
+typedef struct sample_s {
+    u8 *row; // ---------------------------------- raw header and columns of the first row of the chunk, as compared by keys_compare()
+    i64 chunk; // -------------------------------- offset of the chunk
+} sample_t;
+
+typedef struct input_s {
+    FILE *file;
+    char *path;
+    sample_t *samples;
+    i32 num_samples;
+    i32 capacity; // ----------------------------- the most samples to take
+} input_t;
+
+typedef struct worker_s {
+    readbuf_t rbuf;
+    writebuf_t wbuf;
+    FILE *out[1];
+    u8 *lo; // ----------------------------------- first row of the range, or NULL for the start of the key space
+    u8 *hi; // ----------------------------------- first row past the range, or NULL for the end of the key space
+    pthread_t thread;
+} worker_t;
+
+//
+// with --sum, --count or --dedupe, merged rows are folded as they are
+// written, exactly as piping the merge into bsumeach, bcounteach or
+// bdedupe would. the inputs are sorted, so rows with identical first
+// columns come out of the merge together and one group at a time is
+// enough.
+//
+
+#define GROUP_NONE 0
+#define GROUP_SUM 1
+#define GROUP_COUNT 2
+#define GROUP_DEDUPE 3
+
+typedef struct group_s {
+    u8 *key; // ---------------------------------- first column of the rows being folded
+    i32 size;
+    i32 capacity;
+    bool open;
+    i64 count;
+    u64 sum; // ---------------------------------- read and written as sum_type
+    i32 sum_size;
+} group_t;
+
+bool composite;
+i32 value_type;
+bool lz4;
+i32 grouping = GROUP_NONE;
+i32 sum_type;
+input_t *inputs;
+i32 num_inputs;
+i32 next_input = 0;
+pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+// write the group folded so far, if there is one
+inlined void group_flush(writebuf_t *wbuf, group_t *group) {
+    row_t row;
+    if (!group->open || grouping == GROUP_DEDUPE) // ---------------------------------------------------------- dedupe wrote the first row of the group when it opened
+        return;
+    row.max = 1;
+    row.columns[0] = group->key;
+    row.sizes[0] = group->size;
+    if (grouping == GROUP_COUNT) {
+        row.columns[1] = &group->count;
+        row.sizes[1] = sizeof(i64);
+    } else {
+        row.columns[1] = &group->sum;
+        row.sizes[1] = group->sum_size;
+    }
+    dump(wbuf, &row, 0);
+}
+
+// write a merged row, or fold it into the group of rows with its first column
+inlined void group_write(writebuf_t *wbuf, group_t *group, raw_row_t *raw_row) {
+    u8 *key = raw_row->buffer;
+    i32 size = FROM_UINT16(raw_row->header + sizeof(u16));
+    u8 *value = key + size + 1;
+    if (grouping == GROUP_NONE) {
+        dump_raw(wbuf, raw_row, 0);
+        return;
+    }
+    if (!group->open || size != group->size || memcmp(key, group->key, size) != 0) {
+        group_flush(wbuf, group);
+        if (size + 1 > group->capacity) {
+            group->capacity = size + 1;
+            REALLOC(group->key, group->capacity);
+        }
+        memcpy(group->key, key, size + 1); // +1 for the trailing \0
+        group->size = size;
+        group->open = true;
+        group->count = 0;
+        group->sum = 0;
+        if (grouping == GROUP_DEDUPE)
+            dump_raw(wbuf, raw_row, 0);
+    }
+    group->count++;
+    if (grouping == GROUP_SUM) {
+        ASSERT(FROM_UINT16(raw_row->header) >= 1, "fatal: need at least 2 columns\n");
+        group->sum_size = FROM_UINT16(raw_row->header + sizeof(u16) * 2);
+        ASSERT_SIZE(sum_type, group->sum_size);
+        switch (sum_type) {
+            case I64: *(i64*)&group->sum += *(i64*)value; break;
+            case I32: *(i32*)&group->sum += *(i32*)value; break;
+            case I16: *(i16*)&group->sum += *(i16*)value; break;
+            case U64: *(u64*)&group->sum += *(u64*)value; break;
+            case U32: *(u32*)&group->sum += *(u32*)value; break;
+            case U16: *(u16*)&group->sum += *(u16*)value; break;
+            case F64: *(f64*)&group->sum += *(f64*)value; break;
+            case F32: *(f32*)&group->sum += *(f32*)value; break;
+        }
+    }
+}
+
+// merge the rows of every input of rbuf from lo until hi into wbuf
+void merge(readbuf_t *rbuf, i32 num_files, writebuf_t *wbuf, u8 *lo, u8 *hi) {
+    row_t row;
+    raw_row_t *slots;
+    group_t group = {0};
+    i32 i;
+    bool exact = !composite && radix_type(value_type); // -------------------------------------------------------- a numeric first column is ordered by its key alone
+    losertree_t lt = losertree_init(num_files, exact, composite ? sort_keys_compare : compare_fn(value_type));
+    MALLOC(slots, sizeof(raw_row_t) * MAX(1, num_files));
+
+    // seed the tree with the first row in range of each input, each of which owns a slot for its rows
+    for (i = 0; i < num_files; i++) {
+        while (1) {
+            load_next(rbuf, &row, i);
+            if (row.stop)
+                break;
+            keys_check(&sort_keys, &row);
+            if (!lo || keys_compare(&sort_keys, keys_header(&row), lo) >= 0)
+                break;
+        }
+        if (row.stop || (hi && keys_compare(&sort_keys, keys_header(&row), hi) >= 0))
+            continue;
+        row_to_raw(&row, &slots[i]);
+        losertree_set(&lt, i, keys_first(&sort_keys, slots[i].header), composite ? slots[i].header : slots[i].buffer);
+    }
+    losertree_build(&lt);
+
+    // process input row by row
+    while ((i = losertree_winner(&lt)) != -1) {
+        group_write(wbuf, &group, &slots[i]);
+        load_next(rbuf, &row, i);
+        if (row.stop) {
+            losertree_done(&lt, i);
+        } else {
+            keys_check(&sort_keys, &row);
+            if (hi && keys_compare(&sort_keys, keys_header(&row), hi) >= 0) // -------------------------------------- inputs are sorted, so the rest of this one is past the range too
+                losertree_done(&lt, i);
+            else {
+                row_to_raw(&row, &slots[i]);
+                losertree_set(&lt, i, keys_first(&sort_keys, slots[i].header), composite ? slots[i].header : slots[i].buffer);
+            }
+        }
+        losertree_replay(&lt, i);
+    }
+    group_flush(wbuf, &group);
+    dump_flush(wbuf, 0);
+    losertree_free(&lt);
+    free(slots);
+    free(group.key);
+}
+
+// a raw row of only a first column of key, copied into arena
+inlined u8 *sample_key(arena_t *arena, u8 *key, i32 size) {
+    u8 *row = arena_alloc(arena, sizeof(u16) * 2 + size + 1);
+    u16 max = 0;
+    u16 key_size = size;
+    ASSERT_SIZE(value_type, size);
+    memcpy(row, &max, sizeof(u16));
+    memcpy(row + sizeof(u16), &key_size, sizeof(u16));
+    memcpy(row + sizeof(u16) * 2, key, size);
+    row[sizeof(u16) * 2 + size] = '\0';
+    return row;
+}
+
+// a copy of the raw row at the start of chunk, in arena unless it is too big for a block
+inlined u8 *sample_row(arena_t *arena, u8 *chunk) {
+    row_t row;
+    i32 size = row_from_raw(chunk, &row);
+    u8 *copy;
+    keys_check(&sort_keys, &row);
+    if (size > ARENA_BLOCK_SIZE)
+        MALLOC(copy, size);
+    else
+        copy = arena_alloc(arena, size);
+    memcpy(copy, chunk, size);
+    return copy;
+}
+
+inlined void sample_add(input_t *input, u8 *row, i64 chunk) {
+    ASSERT(input->num_samples < input->capacity, "fatal: too many samples\n");
+    input->samples[input->num_samples++] = (sample_t){row, chunk};
+}
+
+// sample every k-th chunk of an input from its index, when the key is the first column and the index is up to date
+bool sample_index(input_t *input, arena_t *arena) {
+    char path[PATH_MAX];
+    struct stat data_st;
+    struct stat index_st;
+    if (composite || !input->path)
+        return false;
+    SNPRINTF(path, sizeof(path), "%s.idx", input->path);
+    if (0 != stat(path, &index_st) || 0 != fstat(fileno(input->file), &data_st) || index_st.st_mtime < data_st.st_mtime)
+        return false;
+    index_t index = index_load(path, input->file);
+    i32 k = MAX(1, (index.size + input->capacity - 1) / input->capacity);
+    for (i32 i = 0; i < index.size; i += k)
+        sample_add(input, sample_key(arena, index.first[i], index.first_sizes[i]), index.offsets[i]);
+    return true;
+}
+
+// sample the first row of a chunk every so many bytes of an input, passing over the chunks in between without decompressing them
+void sample_input(input_t *input, arena_t *arena) {
+    if (sample_index(input, arena))
+        return;
+    readbuf_t rbuf = rbuf_init(&input->file, 1, lz4);
+    rbuf.verify = false; // -------------------------------------------------------------------------------- the workers read it all again, and verify it then
+    ASSERT(rbuf.mmaps[0], "fatal: failed to map input\n");
+    struct stat st;
+    ASSERT(0 == fstat(fileno(input->file), &st), "fatal: failed to stat input\n");
+    i64 step = MAX(1, (st.st_size + input->capacity - 1) / input->capacity); // ------------------------------ chunk starts are all before st_size, so this takes at most capacity samples
+    i64 next = 0;
+    i64 chunk;
+    chunk_stats_t *stats = &rbuf.stats[0];
+    u8 *raw;
+    i32 size;
+    while (read_peek(&rbuf, 0)) {
+        chunk = rbuf.chunk_start[0];
+        if (chunk < next) {
+            read_skip(&rbuf, &raw, 0);
+            continue;
+        }
+        next = chunk + step;
+        if (!composite && stats->type == stats_type(value_type)) { // ---------------------------------------- the first key of a sorted chunk is its min, or its max when reversed
+            if (value_type >= R_STR)
+                sample_add(input, sample_key(arena, stats->max, stats->max_size), chunk);
+            else
+                sample_add(input, sample_key(arena, stats->min, stats->min_size), chunk);
+            read_skip(&rbuf, &raw, 0);
+        } else {
+            size = read_chunk(&rbuf, &rbuf.buffers[0], rbuf.codec_buf, 0);
+            if (size > 0)
+                sample_add(input, sample_row(arena, rbuf.buffers[0]), chunk);
+        }
+    }
+    rbuf_free(&rbuf);
+    ASSERT(0 == fseeko(input->file, 0, SEEK_SET), "fatal: failed to rewind input\n");
+}
+
+void *sample_worker(void *arg) {
+    (void)arg;
+    arena_t arena = arena_init(); // -------------------------------------------------------------------------- the samples live until the merge is done, so the arena is never freed
+    i32 i;
+    while (1) {
+        MUTEX_LOCK(lock);
+        i = next_input < num_inputs ? next_input++ : -1;
+        MUTEX_UNLOCK(lock);
+        if (i == -1)
+            break;
+        sample_input(&inputs[i], &arena);
+    }
+    return NULL;
+}
+
+int sample_compare(const void *a, const void *b) {
+    return keys_compare(&sort_keys, *(u8**)a, *(u8**)b);
+}
+
+// the last sample of input whose row is before lo, which is where a worker for lo starts reading it
+sample_t *sample_start(input_t *input, u8 *lo) {
+    i32 left = 0;
+    i32 right = input->num_samples;
+    i32 mid;
+    if (!lo)
+        return NULL;
+    while (left < right) { // -------------------------------------------------------------------------------- samples of an input are in order, so find the first one not before lo
+        mid = left + (right - left) / 2;
+        if (keys_compare(&sort_keys, input->samples[mid].row, lo) < 0)
+            left = mid + 1;
+        else
+            right = mid;
+    }
+    return left ? &input->samples[left - 1] : NULL;
+}
+
+void *merge_worker(void *arg) {
+    worker_t *w = arg;
+    merge(&w->rbuf, num_inputs, &w->wbuf, w->lo, w->hi);
+    return NULL;
+}
+
+// point a worker's output at a new temp file
+void worker_open(worker_t *w, char *tmpdir) {
+    w->out[0] = temp_open(tmpdir, "bmerge");
+}
+
+// set up a worker to read every input from its last sample before lo
+void worker_init(worker_t *w, FILE **files, u8 *lo, u8 *hi, bool verify, i32 prefetch) {
+    sample_t *start;
+    w->lo = lo;
+    w->hi = hi;
+    for (i32 i = 0; i < num_inputs; i++) { // ------------------------------------------------------------ the inputs are mapped from where they are positioned, one worker at a time
+        start = sample_start(&inputs[i], lo);
+        ASSERT(0 == fseeko(files[i], start ? start->chunk : 0, SEEK_SET), "fatal: failed to seek input\n");
+    }
+    w->rbuf = rbuf_init(files, num_inputs, lz4);
+    w->rbuf.verify = verify;
+    for (i32 i = 0; i < num_inputs; i++)
+        ASSERT(w->rbuf.mmaps[i], "fatal: failed to map input\n");
+    if (prefetch)
+        rbuf_prefetch(&w->rbuf, prefetch);
+}
+
 int main(int argc, char **argv) {
 
     // setup bsv
     SETUP();
 
     // parse args
-    bool lz4 = false;
     bool reversed = false;
+    i32 prefetch = 0;
+    bool verify = true;
+    char *index_path = NULL;
+    bool stats = false;
+    i32 jobs = 1;
+    char *tmpdir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    lz4 = false;
     ARGH_PARSE {
         ARGH_NEXT();
-        if      ARGH_BOOL("-r", "--reversed") { reversed = true; }
-        else if ARGH_BOOL("-l", "--lz4")      { lz4 = true; }
+        if      ARGH_BOOL("-r", "--reversed")  { reversed = true; }
+        else if ARGH_BOOL("-l", "--lz4")       { lz4 = true; }
+        else if ARGH_FLAG("-P", "--prefetch")  { ASSERT(isdigits(ARGH_VAL()), "fatal: should have been `--prefetch INT`, not `--prefetch %s`\n", ARGH_VAL());
+                                                 prefetch = atol(ARGH_VAL()); }
+        else if ARGH_BOOL("-n", "--no-verify") { verify = false; }
+        else if ARGH_FLAG("-i", "--index")     { index_path = ARGH_VAL(); }
+        else if ARGH_BOOL("-s", "--stats")     { stats = true; }
+        else if ARGH_FLAG("-S", "--sum")       { sum_type = keys_type(ARGH_VAL());
+                                                 ASSERT(sum_type != STR, "fatal: should have been `--sum TYPE` of a number, not `--sum %s`\n", ARGH_VAL());
+                                                 ASSERT(grouping == GROUP_NONE, "fatal: only one of --sum, --count and --dedupe\n");
+                                                 grouping = GROUP_SUM; }
+        else if ARGH_BOOL("-c", "--count")     { ASSERT(grouping == GROUP_NONE, "fatal: only one of --sum, --count and --dedupe\n");
+                                                 grouping = GROUP_COUNT; }
+        else if ARGH_BOOL("-d", "--dedupe")    { ASSERT(grouping == GROUP_NONE, "fatal: only one of --sum, --count and --dedupe\n");
+                                                 grouping = GROUP_DEDUPE; }
+        else if ARGH_FLAG("-j", "--jobs")      { ASSERT(isdigits(ARGH_VAL()) && atol(ARGH_VAL()) > 0, "fatal: should have been `--jobs INT`, not `--jobs %s`\n", ARGH_VAL());
+                                                 jobs = atol(ARGH_VAL()); }
+        else if ARGH_FLAG("-T", "--tmpdir")    { tmpdir = ARGH_VAL(); }
     }
+    ASSERT(jobs == 1 || !index_path, "fatal: --index is not supported with --jobs\n");
 
     // setup input, filenames come in on stdin
     ARRAY_INIT(files, FILE*);
+    ARRAY_INIT(paths, char*);
     ARRAY_INIT(filename, u8);
     u8 tmp;
     FILE* file;
@@ -42,6 +410,7 @@ int main(int argc, char **argv) {
                 ARRAY_APPEND(filename, '\0', u8);
                 FOPEN(file, filename, "rb");
                 ARRAY_APPEND(files, file, FILE*);
+                ARRAY_APPEND(paths, strdup((char*)filename), char*);
                 ARRAY_RESET(filename);
             }
         } else {
@@ -49,13 +418,18 @@ int main(int argc, char **argv) {
         }
     }
     ASSERT(ARRAY_SIZE(files) < USHRT_MAX, "fatal: too many files\n");
-    readbuf_t rbuf = rbuf_init(files, ARRAY_SIZE(files), lz4);
+    num_inputs = ARRAY_SIZE(files);
 
     // setup output
     writebuf_t wbuf = wbuf_init((FILE*[]){stdout}, 1, false);
+    if (index_path)
+        wbuf_index(&wbuf, index_path);
 
-    i32 value_type;
-    if (!ARGH_ARGC)
+    sort_keys.size = 0;
+    if (ARGH_ARGC == 1 && keys_spec(ARGH_ARGV[0])) {
+        sort_keys = keys_parse(ARGH_ARGV[0], reversed);
+        value_type = sort_keys.types[0];
+    } else if (!ARGH_ARGC)
         if (reversed)
             value_type = R_STR;
         else
@@ -84,63 +458,86 @@ int main(int argc, char **argv) {
             else ASSERT(0, "fatal: bad type %s\n", ARGH_ARGV[0]);
         }
     }
+    if (!sort_keys.size)
+        sort_keys = keys_single(value_type);
+    composite = keys_composite(&sort_keys);
+    ASSERT(jobs == 1 || !composite || grouping == GROUP_NONE, "fatal: --jobs with --sum, --count or --dedupe needs the key to be the first column\n"); // -- else a group could span ranges
+    ASSERT(sort_keys.columns[0] == 0 || (!stats && !index_path), "fatal: --stats and --index need the key to start with the first column\n");
+    if (stats)
+        wbuf_stats(&wbuf, value_type);
 
-    // setup state
-    row_t row;
-    raw_row_t *raw_row;
-    heap h;
-    switch (value_type) {
-        // normal
-        case STR: heap_create(&h, ARRAY_SIZE(files), compare_str); break;
-        case I64: heap_create(&h, ARRAY_SIZE(files), compare_i64); break;
-        case I32: heap_create(&h, ARRAY_SIZE(files), compare_i32); break;
-        case I16: heap_create(&h, ARRAY_SIZE(files), compare_i16); break;
-        case U64: heap_create(&h, ARRAY_SIZE(files), compare_u64); break;
-        case U32: heap_create(&h, ARRAY_SIZE(files), compare_u32); break;
-        case U16: heap_create(&h, ARRAY_SIZE(files), compare_u16); break;
-        case F64: heap_create(&h, ARRAY_SIZE(files), compare_f64); break;
-        case F32: heap_create(&h, ARRAY_SIZE(files), compare_f32); break;
-        // reverse
-        case R_STR: heap_create(&h, ARRAY_SIZE(files), compare_r_str); break;
-        case R_I64: heap_create(&h, ARRAY_SIZE(files), compare_r_i64); break;
-        case R_I32: heap_create(&h, ARRAY_SIZE(files), compare_r_i32); break;
-        case R_I16: heap_create(&h, ARRAY_SIZE(files), compare_r_i16); break;
-        case R_U64: heap_create(&h, ARRAY_SIZE(files), compare_r_u64); break;
-        case R_U32: heap_create(&h, ARRAY_SIZE(files), compare_r_u32); break;
-        case R_U16: heap_create(&h, ARRAY_SIZE(files), compare_r_u16); break;
-        case R_F64: heap_create(&h, ARRAY_SIZE(files), compare_r_f64); break;
-        case R_F32: heap_create(&h, ARRAY_SIZE(files), compare_r_f32); break;
-    }
-
-    // seed the heap with the first row of each input
-    for (i32 i = 0; i < ARRAY_SIZE(files); i++) {
-        load_next(&rbuf, &row, i);
-        if (row.stop)
-            continue;
-        ASSERT_SIZE(value_type, row.sizes[0]);
-        MALLOC(raw_row, sizeof(raw_row_t));
-        row_to_raw(&row, raw_row);
-        raw_row->meta = i;
-        heap_insert(&h, raw_row->buffer, raw_row);
+    // merge in one pass
+    if (jobs == 1 || !num_inputs) {
+        readbuf_t rbuf = rbuf_init(files, num_inputs, lz4);
+        rbuf.verify = verify; // -------------------------------------------------- skip checksums for trusted input
+        if (prefetch)
+            rbuf_prefetch(&rbuf, prefetch);
+        merge(&rbuf, num_inputs, &wbuf, NULL, NULL);
+        return 0;
     }
 
-    // process input row by row
-    while (1) {
-        if (!heap_size(&h))
-            break;
-        ASSERT(1 == heap_delmin(&h, NULL, &raw_row), "fatal: heap_delmin failed\n");
-        i32 i = raw_row->meta;
-        dump_raw(&wbuf, raw_row, 0);
-        load_next(&rbuf, &row, i);
-        if (row.stop) {
-            continue;
+    // sample every input, concurrently. empty inputs have nothing to merge, and every other input is mapped.
+    struct stat st;
+    pthread_t *threads;
+    MALLOC(threads, sizeof(pthread_t) * jobs);
+    MALLOC(inputs, sizeof(input_t) * num_inputs);
+    size = 0;
+    for (i32 i = 0; i < num_inputs; i++) {
+        ASSERT(0 == fstat(fileno(files[i]), &st) && S_ISREG(st.st_mode), "fatal: --jobs needs inputs that are regular files\n");
+        if (st.st_size) {
+            paths[size] = paths[i];
+            files[size++] = files[i];
+        }
+    }
+    num_inputs = size;
+    for (i32 i = 0; i < num_inputs; i++) {
+        inputs[i] = (input_t){files[i], paths[i], NULL, 0, jobs * SAMPLES_PER_JOB};
+        MALLOC(inputs[i].samples, sizeof(sample_t) * inputs[i].capacity);
+    }
+    for (i32 i = 0; i < jobs; i++)
+        THREAD_CREATE(threads[i], sample_worker, NULL);
+    for (i32 i = 0; i < jobs; i++)
+        THREAD_JOIN(threads[i]);
+
+    // pick splitters evenly from every sample, in order
+    ARRAY_INIT(splitters, u8*);
+    for (i32 i = 0; i < num_inputs; i++)
+        for (i32 j = 0; j < inputs[i].num_samples; j++)
+            ARRAY_APPEND(splitters, inputs[i].samples[j].row, u8*);
+    qsort(splitters, ARRAY_SIZE(splitters), sizeof(u8*), sample_compare);
+    jobs = MIN(jobs, MAX(1, ARRAY_SIZE(splitters)));
+
+    // merge a range per job, the first to stdout and the rest to temp files
+    worker_t *workers;
+    MALLOC(workers, sizeof(worker_t) * jobs);
+    for (i32 i = 0; i < jobs; i++) {
+        worker_t *w = &workers[i];
+        u8 *lo = i == 0 ? NULL : splitters[ARRAY_SIZE(splitters) * i / jobs];
+        u8 *hi = i == jobs - 1 ? NULL : splitters[ARRAY_SIZE(splitters) * (i + 1) / jobs];
+        worker_init(w, files, lo, hi, verify, prefetch);
+        if (i == 0) {
+            w->wbuf = wbuf;
         } else {
-            ASSERT_SIZE(value_type, row.sizes[0]);
-            row_to_raw(&row, raw_row);
-            raw_row->meta = i;
-            heap_insert(&h, raw_row->buffer, raw_row);
+            worker_open(w, tmpdir);
+            w->wbuf = wbuf_init(w->out, 1, false);
+            if (stats)
+                wbuf_stats(&w->wbuf, value_type);
         }
+        THREAD_CREATE(w->thread, merge_worker, w);
+    }
+    for (i32 i = 0; i < jobs; i++)
+        THREAD_JOIN(workers[i].thread);
+
+    // append the temp files to stdout in order
+    u8 *buffer;
+    MALLOC(buffer, BUFFER_SIZE);
+    for (i32 i = 1; i < jobs; i++) {
+        file = workers[i].out[0];
+        ASSERT(0 == fflush(file) && 0 == fseeko(file, 0, SEEK_SET), "fatal: failed to rewind temp file\n");
+        while ((size = fread_unlocked(buffer, 1, BUFFER_SIZE, file)))
+            FWRITE(buffer, size, stdout);
+        ASSERT(!ferror_unlocked(file), "fatal: failed to read temp file\n");
+        ASSERT(fclose(file) != EOF, "fatal: failed to close temp file\n");
     }
-    dump_flush(&wbuf, 0);
 
 }
@@ -3,16 +3,406 @@
 #include "load.h"
 #include "dump.h"
 #include "xxh3.h"
+#include "ordered.h"
+#include "keys.h"
 #include <errno.h>
 #include <sys/stat.h>
+#include <sys/resource.h>
 #include <ctype.h>
 
 #define SEED 0
 
-#define DESCRIPTION "split into multiple files by consistent hash of the first column value\n\n"
-#define USAGE "\n... | bpartition NUM_BUCKETS [PREFIX] [-l|--lz4]\n\n"
+#define DESCRIPTION "split into multiple files by consistent hash of the first column value, or by ranges of it\n\n"
+#define USAGE "\n... | bpartition NUM_BUCKETS [PREFIX] [-l|--lz4] [-c CODEC|--codec CODEC] [-x|--checksum] [-s|--stats] [-w N|--writers N] [-j N|--jobs N] [-m SIZE|--memory-limit SIZE] [-R TYPE|--range TYPE] [-S FILE|--splitters FILE]\n\n"
 #define EXAMPLE ">> echo '\na\nb\nc\n' | bsv | bpartition 10 prefix\nprefix03\nprefix06\n"
 
+//
+// with --jobs, whole input chunks are handed to workers, which find the
+// bucket of every row and group the rows of their chunk by bucket. the
+// groups of each chunk are then appended to the writebuf in input order,
+// so every bucket gets its rows in the same order as without --jobs.
+// compressing the chunks of the writebuf is left to async writers.
+//
+
+FILE **files;
+i32 num_buckets;
+i32 codec;
+bool checksum;
+i32 stats;
+writebuf_t *output;
+
+//
+// with --range TYPE, rows go to buckets by the value of their first
+// column instead of its hash. NUM_BUCKETS - 1 ascending splitters divide
+// the values, and a row goes to the bucket after the last splitter not
+// greater than it, so equal values share a bucket and every value in a
+// bucket sorts before every value in the next. bsorting each bucket on
+// its own and concatenating them in order is then a global sort.
+//
+// splitters are the first columns of the rows of --splitters FILE, or
+// are picked evenly from a reservoir sample of stdin, which is then read
+// again from the start, so it must be a regular file. numeric values
+// are mapped to u64 keys by radix_key() and found by a branchless binary
+// search, strings by a binary search with compare().
+//
+
+#define RANGE_SAMPLE_PER_BUCKET 128
+#define RANGE_SAMPLE_MAX (1 << 20)
+
+i32 range_type = -1;
+i32 num_splitters = 0;
+u64 *splitter_keys;
+u8 **splitter_strs;
+
+int range_compare_keys(const void *a, const void *b) {
+    u64 x = *(u64*)a;
+    u64 y = *(u64*)b;
+    return (x > y) - (x < y);
+}
+
+int range_compare_strs(const void *a, const void *b) {
+    return compare_str(*(u8**)a, *(u8**)b);
+}
+
+inlined void range_copy(u8 **dst, row_t *row) {
+    MALLOC(*dst, row->sizes[0] + 1);
+    memcpy(*dst, row->columns[0], row->sizes[0] + 1); // +1 for the trailing \0
+}
+
+// the number of splitters not greater than the first column of row
+inlined i32 range_bucket(row_t *row) {
+    const u64 *base = splitter_keys;
+    i32 size = num_splitters;
+    i32 half;
+    i32 lo = 0;
+    i32 hi = num_splitters;
+    i32 mid;
+    u64 key;
+    ASSERT_SIZE(range_type, row->sizes[0]);
+    if (range_type == STR) {
+        while (lo < hi) {
+            mid = (lo + hi) / 2;
+            if (compare_str(splitter_strs[mid], row->columns[0]) <= 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+    if (!size)
+        return 0;
+    key = radix_key(range_type, row->columns[0]);
+    while (size > 1) { // --------------------------------------------------------------------------------- everything before base is not greater than key, and the select compiles to a cmov
+        half = size / 2;
+        base = base[half] <= key ? base + half : base;
+        size -= half;
+    }
+    return (base - splitter_keys) + (*base <= key);
+}
+
+inlined u64 bucket_of(row_t *row) {
+    if (range_type != -1)
+        return range_bucket(row);
+    return XXH3_64bits(row->columns[0], row->sizes[0]) % num_buckets;
+}
+
+// read splitters from the first column of every row of path
+void range_load(char *path) {
+    FILE *file;
+    row_t row;
+    u64 key;
+    FOPEN(file, path, "rb");
+    readbuf_t rbuf = rbuf_init((FILE*[]){file}, 1, false);
+    MALLOC(splitter_keys, sizeof(u64) * num_buckets);
+    MALLOC(splitter_strs, sizeof(u8*) * num_buckets);
+    while (1) {
+        load_next(&rbuf, &row, 0);
+        if (row.stop)
+            break;
+        ASSERT(num_splitters < num_buckets - 1, "fatal: %s has more than NUM_BUCKETS - 1 splitters\n", path);
+        ASSERT_SIZE(range_type, row.sizes[0]);
+        if (range_type == STR) {
+            ASSERT(!num_splitters || compare_str(splitter_strs[num_splitters - 1], row.columns[0]) <= 0, "fatal: splitters are not ascending in %s\n", path);
+            range_copy(&splitter_strs[num_splitters], &row);
+        } else {
+            key = radix_key(range_type, row.columns[0]);
+            ASSERT(!num_splitters || splitter_keys[num_splitters - 1] <= key, "fatal: splitters are not ascending in %s\n", path);
+            splitter_keys[num_splitters] = key;
+        }
+        num_splitters++;
+    }
+    ASSERT(num_splitters == num_buckets - 1, "fatal: %s should have NUM_BUCKETS - 1 splitters, got: %d\n", path, num_splitters);
+    rbuf_free(&rbuf);
+    ASSERT(fclose(file) != EOF, "fatal: failed to close files\n");
+}
+
+// pick splitters from a reservoir sample of rbuf, which is left at its end
+void range_sample(readbuf_t *rbuf) {
+    i32 capacity = MIN(RANGE_SAMPLE_MAX, (i64)num_buckets * RANGE_SAMPLE_PER_BUCKET);
+    i64 seen = 0;
+    i64 slot;
+    i64 size;
+    u64 *keys;
+    u8 **strs;
+    row_t row;
+    MALLOC(keys, sizeof(u64) * capacity);
+    MALLOC(strs, sizeof(u8*) * capacity);
+    while (1) {
+        load_next(rbuf, &row, 0);
+        if (row.stop)
+            break;
+        ASSERT_SIZE(range_type, row.sizes[0]);
+        slot = seen < capacity ? seen : XXH3_64bits(&seen, sizeof(i64)) % (seen + 1); // ---------------------- a hash of the row number is random enough, and repeatable
+        if (slot < capacity) {
+            if (range_type == STR) {
+                if (seen >= capacity)
+                    free(strs[slot]);
+                range_copy(&strs[slot], &row);
+            } else {
+                keys[slot] = radix_key(range_type, row.columns[0]);
+            }
+        }
+        seen++;
+    }
+    size = MIN(seen, capacity);
+    if (range_type == STR)
+        qsort(strs, size, sizeof(u8*), range_compare_strs);
+    else
+        qsort(keys, size, sizeof(u64), range_compare_keys);
+    MALLOC(splitter_keys, sizeof(u64) * num_buckets);
+    MALLOC(splitter_strs, sizeof(u8*) * num_buckets);
+    num_splitters = size ? num_buckets - 1 : 0;
+    for (i32 i = 0; i < num_splitters; i++) {
+        splitter_keys[i] = keys[(i + 1) * size / num_buckets];
+        splitter_strs[i] = strs[(i + 1) * size / num_buckets];
+    }
+    free(keys);
+}
+
+// group the rows of a chunk by bucket into chunk->out, laid out as the byte size of every bucket's group, then the groups in bucket order
+void scatter_chunk(ordered_chunk_t *chunk) {
+    static __thread i32 *offsets = NULL;
+    static __thread i32 *row_buckets = NULL;
+    static __thread i32 *row_sizes = NULL;
+    static __thread i32 capacity = 0;
+    i32 *sizes = (i32*)chunk->out;
+    u8 *groups = chunk->out + sizeof(i32) * num_buckets;
+    row_t row;
+    i32 num_rows = 0;
+    i32 offset;
+    if (!offsets)
+        MALLOC(offsets, sizeof(i32) * num_buckets);
+    memset(sizes, 0, sizeof(i32) * num_buckets);
+    for (offset = 0; offset < chunk->size; offset += row_sizes[num_rows++]) { // ------------------------- the rows of a chunk are already laid out as dump() would, so they are copied as they are
+        if (num_rows == capacity) {
+            capacity = MAX(1024, capacity * 2);
+            REALLOC(row_buckets, sizeof(i32) * capacity);
+            REALLOC(row_sizes, sizeof(i32) * capacity);
+        }
+        row_sizes[num_rows] = row_from_raw(chunk->in + offset, &row);
+        row_buckets[num_rows] = bucket_of(&row);
+        sizes[row_buckets[num_rows]] += row_sizes[num_rows];
+    }
+    offset = 0;
+    for (i32 i = 0; i < num_buckets; i++) {
+        offsets[i] = offset;
+        offset += sizes[i];
+    }
+    offset = 0;
+    for (i32 i = 0; i < num_rows; i++) {
+        memcpy(groups + offsets[row_buckets[i]], chunk->in + offset, row_sizes[i]);
+        offsets[row_buckets[i]] += row_sizes[i];
+        offset += row_sizes[i];
+    }
+}
+
+// append the groups of a chunk to their buckets, called in input order
+void scatter_done(ordered_chunk_t *chunk) {
+    i32 *sizes = (i32*)chunk->out;
+    u8 *group = chunk->out + sizeof(i32) * num_buckets;
+    u8 *end;
+    row_t row;
+    i32 size;
+    for (i32 i = 0; i < num_buckets; i++) {
+        end = group + sizes[i];
+        if (sizes[i] <= BUFFER_SIZE - output->offset[i]) { // ----------------------------------------------- the whole group fits in one go
+            write_bytes(output, group, sizes[i], i);
+            group = end;
+        }
+        for (; group < end; group += size) { // ---------------------------------------------------------- otherwise go row by row, so no row straddles chunks
+            size = row_from_raw(group, &row);
+            write_start(output, size, i);
+            write_bytes(output, group, size, i);
+        }
+    }
+}
+
+//
+// with --memory-limit, each bucket is staged in a buffer that starts
+// small and doubles as it fills, up to a chunk. when the buffers
+// together outgrow the limit, the largest is written out as a chunk and
+// freed, found at the top of a max heap of buckets by buffer capacity.
+// bucket files are only opened to write a chunk, and at most half of
+// the fd limit stay open, closing the least recently used first, kept
+// at the head of a list of the open buckets threaded through their
+// stages. thousands of buckets then need neither a chunk of memory nor
+// an fd each, nor a scan over all of them. on top of the limit there is
+// a chunk of input, and one for compression.
+//
+
+#define STAGE_INITIAL_SIZE 4096
+
+typedef struct stage_s {
+    u8 *buffer;
+    i32 size;
+    i32 capacity;
+    i32 heap_index; // --------------------------- position in the heap, or -1 without a buffer
+    FILE *file; // ------------------------------- NULL while closed
+    i32 prev; // --------------------------------- neighbours in the list of open files, from least to most recently used, or -1
+    i32 next;
+} stage_t;
+
+char *prefix;
+i32 width;
+stage_t *stages;
+i64 memory_limit = 0;
+i64 staged = 0;
+i32 *heap; // -------------------------------------- buckets with a buffer, the largest first
+i32 heap_size = 0;
+i32 lru_head = -1; // ------------------------------ least recently used open file
+i32 lru_tail = -1; // ------------------------------ most recently used open file
+i32 num_open = 0;
+i32 max_open;
+u8 *codec_buf;
+
+inlined void bucket_path(u8 *path, i32 size, i32 bucket) {
+    if (strlen(prefix) != 0)
+        SNPRINTF(path, size, "%s_%0*d", prefix, width, bucket);
+    else
+        SNPRINTF(path, size, "%0*d", width, bucket);
+}
+
+inlined void heap_set(i32 index, i32 bucket) {
+    heap[index] = bucket;
+    stages[bucket].heap_index = index;
+}
+
+// move the bucket at index up past every smaller parent
+void heap_up(i32 index) {
+    i32 bucket = heap[index];
+    i32 parent;
+    while (index > 0) {
+        parent = (index - 1) / 2;
+        if (stages[heap[parent]].capacity >= stages[bucket].capacity)
+            break;
+        heap_set(index, heap[parent]);
+        index = parent;
+    }
+    heap_set(index, bucket);
+}
+
+// move the bucket at index down past every larger child
+void heap_down(i32 index) {
+    i32 bucket = heap[index];
+    i32 child;
+    while ((child = index * 2 + 1) < heap_size) {
+        if (child + 1 < heap_size && stages[heap[child + 1]].capacity > stages[heap[child]].capacity)
+            child++;
+        if (stages[heap[child]].capacity <= stages[bucket].capacity)
+            break;
+        heap_set(index, heap[child]);
+        index = child;
+    }
+    heap_set(index, bucket);
+}
+
+inlined void lru_remove(i32 bucket) {
+    stage_t *stage = &stages[bucket];
+    if (stage->prev == -1)
+        lru_head = stage->next;
+    else
+        stages[stage->prev].next = stage->next;
+    if (stage->next == -1)
+        lru_tail = stage->prev;
+    else
+        stages[stage->next].prev = stage->prev;
+}
+
+inlined void lru_append(i32 bucket) {
+    stages[bucket].prev = lru_tail;
+    stages[bucket].next = -1;
+    if (lru_tail == -1)
+        lru_head = bucket;
+    else
+        stages[lru_tail].next = bucket;
+    lru_tail = bucket;
+}
+
+// the file of a bucket, opened for appending if it is not already, closing the least recently used if too many are open
+FILE *stage_file(i32 bucket) {
+    u8 path[1024];
+    i32 lru = lru_head;
+    if (!stages[bucket].file) {
+        if (num_open == max_open) {
+            lru_remove(lru);
+            ASSERT(fclose(stages[lru].file) != EOF, "fatal: failed to close files\n");
+            stages[lru].file = NULL;
+            num_open--;
+        }
+        bucket_path(path, sizeof(path), bucket);
+        FOPEN(stages[bucket].file, path, "ab");
+        num_open++;
+    } else
+        lru_remove(bucket);
+    lru_append(bucket);
+    return stages[bucket].file;
+}
+
+void stage_flush(i32 bucket) {
+    stage_t *stage = &stages[bucket];
+    if (stage->size) {
+        write_chunk(stage_file(bucket), stage->buffer, stage->size, codec, codec_buf, checksum, stats);
+        stage->size = 0;
+    }
+}
+
+// write out and free the largest buffer
+void stage_evict() {
+    i32 largest = heap[0];
+    stage_flush(largest);
+    staged -= stages[largest].capacity;
+    free(stages[largest].buffer);
+    stages[largest].buffer = NULL;
+    stages[largest].capacity = 0;
+    stages[largest].heap_index = -1;
+    if (--heap_size) {
+        heap_set(0, heap[heap_size]);
+        heap_down(0);
+    }
+}
+
+inlined void stage_write(i32 bucket, u8 *bytes, i32 size) {
+    stage_t *stage = &stages[bucket];
+    i32 capacity = stage->capacity;
+    ASSERT(size <= BUFFER_SIZE, "fatal: cant write larger than BUFFER_SIZE\n");
+    if (size > BUFFER_SIZE - stage->size)
+        stage_flush(bucket);
+    if (stage->size + size > capacity) {
+        while (stage->size + size > capacity)
+            capacity = MIN(BUFFER_SIZE, MAX(STAGE_INITIAL_SIZE, capacity * 2));
+        REALLOC(stage->buffer, capacity);
+        staged += capacity - stage->capacity;
+        stage->capacity = capacity;
+        if (stage->heap_index == -1)
+            heap_set(heap_size++, bucket);
+        heap_up(stage->heap_index); // -------------------------------------------------------------------- capacity only grows while the bucket is in the heap
+    }
+    memcpy(stage->buffer + stage->size, bytes, size);
+    stage->size += size;
+    while (staged > memory_limit)
+        stage_evict();
+}
+
 int empty_file(char *path) {
     struct stat st;
     if (stat(path, &st) == 0)
@@ -30,20 +420,42 @@ int main(int argc, char **argv) {
 
     // setup state
     row_t row;
-    u8 *prefix;
+    raw_row_t raw_row;
+    struct rlimit rlimit;
     u8 num_buckets_str[16];
     u8 path[1024];
     i32 empty;
-    i32 num_buckets;
     u64 file_num;
-    u64 hash;
+    struct stat st;
+    i64 start;
 
     // parse args
-    bool lz4 = false;
+    codec = CODEC_NONE;
+    checksum = false;
+    stats = NO_STATS;
+    i32 writers = 0;
+    i32 jobs = 1;
+    char *splitters = NULL;
     ARGH_PARSE {
         ARGH_NEXT();
-        if ARGH_BOOL("-l", "--lz4") { lz4 = true; }
+        if      ARGH_BOOL("-l", "--lz4")      { codec = CODEC_LZ4; }
+        else if ARGH_FLAG("-c", "--codec")    { codec = codec_parse(ARGH_VAL()); }
+        else if ARGH_BOOL("-x", "--checksum") { checksum = true; }
+        else if ARGH_BOOL("-s", "--stats")    { stats = stats_type(STR); }
+        else if ARGH_FLAG("-w", "--writers")  { ASSERT(isdigits(ARGH_VAL()), "fatal: should have been `--writers INT`, not `--writers %s`\n", ARGH_VAL());
+                                                writers = atol(ARGH_VAL()); }
+        else if ARGH_FLAG("-j", "--jobs")     { ASSERT(isdigits(ARGH_VAL()) && atol(ARGH_VAL()) > 0, "fatal: should have been `--jobs INT`, not `--jobs %s`\n", ARGH_VAL());
+                                                jobs = atol(ARGH_VAL()); }
+        else if ARGH_FLAG("-m", "--memory-limit") { memory_limit = parse_size(ARGH_VAL());
+                                                    ASSERT(memory_limit > 0, "fatal: should have been `--memory-limit SIZE` like 512M, not `--memory-limit %s`\n", ARGH_VAL()); }
+        else if ARGH_FLAG("-R", "--range")    { range_type = keys_type(ARGH_VAL()); }
+        else if ARGH_FLAG("-S", "--splitters") { splitters = ARGH_VAL(); }
     }
+    ASSERT(!splitters || range_type != -1, "fatal: --splitters needs --range TYPE\n");
+    if (stats != NO_STATS && range_type != -1)
+        stats = stats_type(range_type); // ---------------------------------------------------------- ranges compare the first column as their type, so its stats do too
+    ASSERT(jobs == 1 || !writers, "fatal: --jobs compresses on as many writers of its own, so --writers is not needed\n");
+    ASSERT(!memory_limit || (jobs == 1 && !writers), "fatal: --memory-limit is not supported with --jobs or --writers\n");
     ASSERT(ARGH_ARGC >= 1, "usage: %s", USAGE);
     ASSERT(strlen(ARGH_ARGV[0]) <= 8, "NUM_BUCKETS must be less than 1e8, got: %s\n", argv[1]);
     num_buckets = atoi(ARGH_ARGV[0]);
@@ -54,33 +466,101 @@ int main(int argc, char **argv) {
         prefix = "";
     }
 
-    // open output files
-    FILE *files[num_buckets];
     SNPRINTF(num_buckets_str, sizeof(num_buckets_str), "%d", num_buckets);
+    width = strlen(num_buckets_str);
+
+    // with --range, read or sample the splitters
+    if (range_type != -1 && num_buckets > 1) {
+        if (splitters) {
+            range_load(splitters);
+        } else {
+            ASSERT(0 == fstat(fileno(stdin), &st) && S_ISREG(st.st_mode), "fatal: --range without --splitters reads stdin twice, so it must be a regular file\n");
+            start = ftello(stdin);
+            range_sample(&rbuf);
+            rbuf_free(&rbuf);
+            ASSERT(0 == fseeko(stdin, start, SEEK_SET), "fatal: failed to seek stdin\n");
+            rbuf = rbuf_init((FILE*[]){stdin}, 1, false);
+        }
+    }
+
+    // with a memory limit, stage buckets in memory and open their files as needed
+    if (memory_limit) {
+        ASSERT(0 == getrlimit(RLIMIT_NOFILE, &rlimit), "fatal: getrlimit\n");
+        max_open = MAX(1, MIN(rlimit.rlim_cur, INT_MAX) / 2);
+        MALLOC(stages, sizeof(stage_t) * num_buckets);
+        memset(stages, 0, sizeof(stage_t) * num_buckets);
+        MALLOC(heap, sizeof(i32) * num_buckets);
+        for (i32 i = 0; i < num_buckets; i++) {
+            stages[i].heap_index = -1;
+            stages[i].prev = -1;
+            stages[i].next = -1;
+        }
+        if (CODEC_TYPE(codec) != CODEC_NONE) {
+            codec_supported(CODEC_TYPE(codec));
+            MALLOC(codec_buf, BUFFER_SIZE_LZ4);
+        }
+        while (1) {
+            load_next(&rbuf, &row, 0);
+            if (row.stop)
+                break;
+            file_num = bucket_of(&row);
+            row_to_raw(&row, &raw_row);
+            stage_write(file_num, raw_row.header, raw_row.header_size + raw_row.buffer_size); // ------------ the header sits right before the columns
+        }
+        for (i32 i = 0; i < num_buckets; i++)
+            stage_flush(i);
+        for (i32 i = 0; i < num_buckets; i++)
+            if (stages[i].file)
+                ASSERT(fclose(stages[i].file) != EOF, "fatal: failed to close files\n");
+        for (i32 i = 0; i < num_buckets; i++) { // ----------------------------------------------------------- only buckets that were written to, now or before, exist
+            bucket_path(path, sizeof(path), i);
+            if (empty_file(path) == 0)
+                FPRINTF(stdout, "%s\n", path);
+        }
+        return 0;
+    }
+
+    // open output files
+    MALLOC(files, sizeof(FILE*) * num_buckets);
     for (i32 i = 0; i < num_buckets; i++) {
-        if (strlen(prefix) != 0)
-            SNPRINTF(path, sizeof(path), "%s_%0*d", prefix, strlen(num_buckets_str), i);
-        else
-            SNPRINTF(path, sizeof(path), "%0*d", strlen(num_buckets_str), i);
+        bucket_path(path, sizeof(path), i);
         FOPEN(files[i], path, "ab");
     }
 
     // setup output
-    writebuf_t wbuf = wbuf_init(files, num_buckets, lz4);
+    writebuf_t wbuf = wbuf_init(files, num_buckets, codec);
+    wbuf.checksum = checksum;
+    wbuf.stats = stats;
+    output = &wbuf;
+    if (jobs > 1 && num_buckets > 1 && CODEC_TYPE(codec) != CODEC_NONE)
+        writers = jobs;
+    if (writers)
+        wbuf_async(&wbuf, writers);
 
-    // for 1 bucket, pipe the data straight through
+    // for 1 bucket, pipe the data straight through a chunk at a time
     if (num_buckets == 1) {
-        i32 rbytes;
         i32 chunk_size;
+        while (-1 != (chunk_size = read_chunk(&rbuf, &rbuf.buffers[0], rbuf.codec_buf, 0))) {
+            write_bytes(&wbuf, rbuf.buffers[0], chunk_size, 0);
+            write_flush(&wbuf, 0);
+        }
+
+    // for more than 1 bucket and more than 1 job, scatter whole chunks on the workers
+    } else if (jobs > 1) {
+        ordered_t *o = ordered_init(jobs, BUFFER_SIZE, sizeof(i32) * num_buckets + BUFFER_SIZE, scatter_chunk, scatter_done);
+        ordered_chunk_t *chunk;
+        u8 *buffer;
         while (1) {
-            rbytes = fread_unlocked(&chunk_size, 1, sizeof(i32), rbuf.files[0]);
-            ASSERT(rbytes == 0 || rbytes == sizeof(i32), "fatal: bad bpartition chunk read %d\n", rbytes);
-            if (rbytes != sizeof(i32))
+            chunk = ordered_next(o);
+            buffer = chunk->in;
+            chunk->size = read_chunk(&rbuf, &buffer, rbuf.codec_buf, 0);
+            if (chunk->size == -1)
                 break;
-            FREAD(wbuf.buffer[0], chunk_size, rbuf.files[0]);
-            wbuf.offset[0] = chunk_size;
-            write_flush(&wbuf, 0);
+            if (buffer != chunk->in) // ----------------------------------------------------------------- zero copy reads point into the mapping instead
+                memcpy(chunk->in, buffer, chunk->size);
+            ordered_submit(o);
         }
+        ordered_finish(o);
 
     // for more than 1 bucket, process input row by row
     } else {
@@ -88,8 +568,7 @@ int main(int argc, char **argv) {
             load_next(&rbuf, &row, 0);
             if (row.stop)
                 break;
-            hash = XXH3_64bits(row.columns[0], row.sizes[0]);
-            file_num = hash % num_buckets;
+            file_num = bucket_of(&row);
             dump(&wbuf, &row, file_num);
         }
     }
@@ -102,10 +581,7 @@ int main(int argc, char **argv) {
 
     // delete any empty output files
     for (i32 i = 0; i < num_buckets; i++) {
-        if (strlen(prefix) != 0)
-            SNPRINTF(path, sizeof(path), "%s_%0*d", prefix, strlen(num_buckets_str), i);
-        else
-            SNPRINTF(path, sizeof(path), "%0*d", strlen(num_buckets_str), i);
+        bucket_path(path, sizeof(path), i);
         empty = empty_file(path);
         if (empty == 1) {
             ASSERT(remove(path) == 0, "fatal: failed to delete file: %s\n", path);
@@ -3,16 +3,121 @@
 #include "dump.h"
 #include "array.h"
 #include "argh.h"
+#include "radix.h"
+#include "losertree.h"
+#include "arena.h"
+#include "keys.h"
 
-#define DESCRIPTION "timsort rows by the first column\n\n"
-#define USAGE "... | bsort [-r|--reversed] [TYPE]\n\n"
+#define DESCRIPTION "timsort rows by the first column, or radix sort them when it is numeric. sort by several columns with a key like 1:i64,3:str,-2:f64, where a negative column is reversed.\n\n"
+#define USAGE "... | bsort [-r|--reversed] [-i INDEX|--index INDEX] [-s|--stats] [-j N|--jobs N] [-m SIZE|--memory-limit SIZE] [-T DIR|--tmpdir DIR] [TYPE|KEY]\n\n"
 #define EXAMPLE ">> echo '\n3\n2\n1\n' | bsv | bschema a:i64 | bsort i64 | bschema i64:a | csv\n1\n2\n3\n\n"
 
-#define SORT_NAME row
-#define SORT_TYPE raw_row_t *
-#define SORT_CMP(x, y) compare((x)->meta, (x)->buffer, (y)->buffer)
+// rows compare by the key of their first field, and only go to the rows on ties
+inlined int prefix_compare(radix_t x, radix_t y) {
+    if (x.key != y.key)
+        return x.key < y.key ? -1 : 1;
+    if (sort_keys.size == 1 && sort_keys.columns[0] == 0) // ------------------------------------------ the common case of a plain first column skips the chain
+        return compare(sort_keys.types[0], ((raw_row_t*)x.val)->buffer, ((raw_row_t*)y.val)->buffer);
+    return keys_compare(&sort_keys, ((raw_row_t*)x.val)->header, ((raw_row_t*)y.val)->header);
+}
+
+#define SORT_NAME prefix
+#define SORT_TYPE radix_t
+#define SORT_CMP(x, y) prefix_compare(x, y)
 #include "sort.h"
 
+#define PSORT_NAME prefix
+#define PSORT_TYPE radix_t
+#define PSORT_CMP(x, y) prefix_compare(x, y)
+#define PSORT_SORT prefix_tim_sort
+#include "psort.h"
+
+#define PSORT_NAME radix
+#define PSORT_TYPE radix_t
+#define PSORT_CMP(x, y) ((x).key < (y).key ? -1 : (x).key > (y).key)
+#define PSORT_SORT radix_sort
+#include "psort.h"
+
+//
+// with a memory limit, input is sorted in runs of about that many
+// bytes, counting chunks and per row overhead. each run is spilled to
+// an unlinked lz4 file in the tmpdir, and the runs are merged into the
+// output once the input is done. merging holds a chunk per run, so
+// when there are more runs than chunks fit in the limit, they are first
+// merged in groups into fewer, longer runs. on top of the limit there
+// are a handful of chunk sized buffers for reading and writing.
+//
+
+#define ROW_OVERHEAD (sizeof(raw_row_t) + sizeof(raw_row_t*) + sizeof(radix_t))
+
+void sort_write(writebuf_t *wbuf, raw_row_t **array, u64 array_size, i32 jobs) {
+    radix_t *keys;
+    MALLOC(keys, sizeof(radix_t) * MAX(1, array_size));
+    for (u64 i = 0; i < array_size; i++) {
+        keys[i].key = keys_first(&sort_keys, array[i]->header);
+        keys[i].val = array[i];
+    }
+    if (sort_keys.size == 1 && radix_type(sort_keys.types[0])) // ---------------------------------------------- the key is the whole order, so no compares are needed
+        radix_psort(keys, array_size, jobs);
+    else
+        prefix_psort(keys, array_size, jobs);
+    for (u64 i = 0; i < array_size; i++)
+        dump_raw(wbuf, keys[i].val, 0);
+    free(keys);
+}
+
+// point run at a new temp file
+FILE *run_open(writebuf_t *run, char *tmpdir) {
+    FILE *file = temp_open(tmpdir, "bsort");
+    run->files[0] = file;
+    return file;
+}
+
+// flush run and rewind its file for reading
+void run_close(writebuf_t *run) {
+    dump_flush(run, 0);
+    ASSERT(0 == fflush(run->files[0]) && 0 == fseeko(run->files[0], 0, SEEK_SET), "fatal: failed to rewind temp file\n");
+}
+
+// merge sorted runs into wbuf, freeing each chunk once its last row is written, and close them
+void run_merge(writebuf_t *wbuf, FILE **runs, i32 num_runs) {
+    readbuf_t rbuf = rbuf_init(runs, num_runs, false);
+    row_t row;
+    raw_row_t *slots;
+    u8 *chunk;
+    i32 i;
+    bool exact = sort_keys.size == 1 && radix_type(sort_keys.types[0]);
+    losertree_t lt = losertree_init(num_runs, exact, sort_keys_compare);
+    MALLOC(slots, sizeof(raw_row_t) * num_runs);
+    for (i = 0; i < num_runs; i++) {
+        load_next(&rbuf, &row, i);
+        if (row.stop)
+            continue;
+        row_to_raw(&row, &slots[i]);
+        losertree_set(&lt, i, keys_first(&sort_keys, slots[i].header), slots[i].header);
+    }
+    losertree_build(&lt);
+    while ((i = losertree_winner(&lt)) != -1) {
+        dump_raw(wbuf, &slots[i], 0);
+        chunk = rbuf.buffers[i];
+        load_next(&rbuf, &row, i);
+        if (rbuf.buffers[i] != chunk && read_owned(&rbuf, chunk, i)) // --------------------------- the last row of that chunk is written, so it is done
+            free(chunk);
+        if (row.stop) {
+            losertree_done(&lt, i);
+        } else {
+            row_to_raw(&row, &slots[i]);
+            losertree_set(&lt, i, keys_first(&sort_keys, slots[i].header), slots[i].header);
+        }
+        losertree_replay(&lt, i);
+    }
+    for (i = 0; i < num_runs; i++)
+        ASSERT(fclose(runs[i]) != EOF, "fatal: failed to close temp file\n");
+    rbuf_free(&rbuf);
+    losertree_free(&lt);
+    free(slots);
+}
+
 int main(int argc, char **argv) {
 
     // setup bsv
@@ -24,16 +129,32 @@ int main(int argc, char **argv) {
     row_t row;
     raw_row_t *raw_row;
     ARRAY_INIT(array, raw_row_t*);
+    arena_t arena = arena_init();
 
     // parse args
     bool reversed = false;
+    bool stats = false;
+    i32 jobs = 1;
+    i64 memory_limit = 0;
+    char *tmpdir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
     ARGH_PARSE {
         ARGH_NEXT();
-        if ARGH_BOOL("-r", "--reversed") { reversed = true; }
+        if      ARGH_BOOL("-r", "--reversed") { reversed = true; }
+        else if ARGH_FLAG("-i", "--index")    { wbuf_index(&wbuf, ARGH_VAL()); }
+        else if ARGH_BOOL("-s", "--stats")    { stats = true; }
+        else if ARGH_FLAG("-j", "--jobs")     { ASSERT(isdigits(ARGH_VAL()), "fatal: should have been `--jobs INT`, not `--jobs %s`\n", ARGH_VAL());
+                                                jobs = atol(ARGH_VAL()); }
+        else if ARGH_FLAG("-m", "--memory-limit") { memory_limit = parse_size(ARGH_VAL());
+                                                    ASSERT(memory_limit > 0, "fatal: should have been `--memory-limit SIZE` like 512M, not `--memory-limit %s`\n", ARGH_VAL()); }
+        else if ARGH_FLAG("-T", "--tmpdir")   { tmpdir = ARGH_VAL(); }
     }
 
     i32 value_type;
-    if (!ARGH_ARGC)
+    sort_keys.size = 0;
+    if (ARGH_ARGC == 1 && keys_spec(ARGH_ARGV[0])) {
+        sort_keys = keys_parse(ARGH_ARGV[0], reversed);
+        value_type = sort_keys.types[0];
+    } else if (!ARGH_ARGC)
         if (reversed)
             value_type = R_STR;
         else
@@ -62,24 +183,74 @@ int main(int argc, char **argv) {
             else ASSERT(0, "fatal: bad type %s\n", ARGH_ARGV[0]);
         }
     }
+    if (!sort_keys.size)
+        sort_keys = keys_single(value_type);
+    ASSERT(sort_keys.columns[0] == 0 || (!stats && !wbuf.index), "fatal: --stats and --index need the key to start with the first column\n");
+    if (stats)
+        wbuf_stats(&wbuf, value_type);
+
+    // setup spilling
+    u8 *chunk = NULL;
+    u64 memory = 0;
+    ARRAY_INIT(chunks, u8*);
+    ARRAY_INIT(runs, FILE*);
+    FILE *run_files[1];
+    writebuf_t run = wbuf_init(run_files, 1, CODEC_LZ4);
 
-    // read
+    // read, spilling a sorted run whenever a new chunk would go over the limit
     while (1) {
         load_next(&rbuf, &row, 0);
         if (row.stop)
             break;
-        ASSERT_SIZE(value_type, row.sizes[0]);
-        MALLOC(raw_row, sizeof(raw_row_t));
+        keys_check(&sort_keys, &row);
+        if (memory_limit && rbuf.buffers[0] != chunk) {
+            if (memory >= memory_limit) {
+                ARRAY_APPEND(runs, run_open(&run, tmpdir), FILE*);
+                sort_write(&run, array, array_size, jobs);
+                run_close(&run);
+                arena_reset(&arena);
+                for (u64 i = 0; i < chunks_size; i++)
+                    free(chunks[i]);
+                ARRAY_RESET(array);
+                ARRAY_RESET(chunks);
+                memory = 0;
+            }
+            chunk = rbuf.buffers[0];
+            if (read_owned(&rbuf, chunk, 0))
+                ARRAY_APPEND(chunks, chunk, u8*);
+            memory += rbuf.chunk_size[0];
+        }
+        raw_row = arena_alloc(&arena, sizeof(raw_row_t));
         row_to_raw(&row, raw_row);
-        raw_row->meta = value_type;
         ARRAY_APPEND(array, raw_row, raw_row_t*);
+        memory += ROW_OVERHEAD;
     }
 
-    // sort
-    row_tim_sort(array, array_size);
+    // everything fit, so sort and write
+    if (!runs_size) {
+        sort_write(&wbuf, array, array_size, jobs);
+        dump_flush(&wbuf, 0);
+        return 0;
+    }
+
+    // spill the last run
+    ARRAY_APPEND(runs, run_open(&run, tmpdir), FILE*);
+    sort_write(&run, array, array_size, jobs);
+    run_close(&run);
+    arena_free(&arena);
+    for (u64 i = 0; i < chunks_size; i++)
+        free(chunks[i]);
 
-    // write
-    for (i32 i = 0; i < array_size; i++)
-        dump_raw(&wbuf, array[i], 0);
+    // merge runs in groups until they all fit in one merge, then merge them into the output
+    i32 fanin = MAX(2, memory_limit / BUFFER_SIZE);
+    u64 first = 0;
+    while (runs_size - first > fanin) {
+        FILE *merged = run_open(&run, tmpdir);
+        run_merge(&run, runs + first, fanin);
+        run_close(&run);
+        ARRAY_APPEND(runs, merged, FILE*);
+        first += fanin;
+    }
+    run_merge(&wbuf, runs + first, runs_size - first);
     dump_flush(&wbuf, 0);
 }
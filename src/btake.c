@@ -16,9 +16,21 @@ int main(int argc, char **argv) {
     // setup state
     row_t row;
     u8 *val = argv[1];
+    u8 *raw;
+    i32 size;
 
     // process input row by row
     while (1) {
+        if (READ_CHUNK_DONE(&rbuf, 0) && read_peek(&rbuf, 0) && rbuf.stats[0].type == STR) { // ------ between chunks, stats may decide a whole chunk without decompressing it
+            if (compare_str(rbuf.stats[0].min, val) > 0 || compare_str(rbuf.stats[0].max, val) < 0) // --- the first row cannot match, time to stop
+                break;
+            if (compare_str(rbuf.stats[0].min, val) == 0 && compare_str(rbuf.stats[0].max, val) == 0) { // every row matches, take the chunk whole
+                write_flush(&wbuf, 0);
+                size = read_skip(&rbuf, &raw, 0);
+                FWRITE(raw, size, stdout);
+                continue;
+            }
+        }
         load_next(&rbuf, &row, 0);
         if (row.stop)
             break;
@@ -2,16 +2,17 @@
 #include "util.h"
 #include "load.h"
 #include "dump.h"
+#include "index.h"
+#include "argh.h"
 
 #define DESCRIPTION "for sorted input, take until the first column is gte to VALUE\n\n"
-#define USAGE "... | btakeuntil VALUE [TYPE]\n\n"
+#define USAGE "... | btakeuntil VALUE [TYPE] [-i INDEX|--index INDEX]\n\n"
 #define EXAMPLE ">> echo '\na\nb\nc\nd\n' | bsv | btakeuntil c | csv\na\nb\n\n"
 
 int main(int argc, char **argv) {
 
     // setup bsv
     SETUP();
-    readbuf_t rbuf = rbuf_init((FILE*[]){stdin}, 1, false);
     readaheadbuf_t rabuf = rabuf_init(1);
     writebuf_t wbuf = wbuf_init((FILE*[]){stdout}, 1, false);
 
@@ -20,7 +21,6 @@ int main(int argc, char **argv) {
     bool matched = false;
     i32 cmp;
     row_t row;
-    ASSERT(argc >= 2, "usage: %s", USAGE);
     i64 val_i64;
     i32 val_i32;
     i16 val_i16;
@@ -31,20 +31,55 @@ int main(int argc, char **argv) {
     f32 val_f32;
     void *val;
     i32 value_type;
-    if (argc == 2) {
-        val = argv[1];
+
+    // parse args
+    char *index_path = NULL;
+    ARGH_PARSE {
+        ARGH_NEXT();
+        if ARGH_FLAG("-i", "--index") { index_path = ARGH_VAL(); }
+    }
+    ASSERT(ARGH_ARGC >= 1, "usage: %s", USAGE);
+    if (ARGH_ARGC == 1) {
+        val = ARGH_ARGV[0];
         value_type = STR;
     } else {
-        ASSERT(argc == 3, "usage: %s", USAGE);
-        if      (strcmp(argv[2], "i64") == 0) { value_type = I64; val_i64 = atol(argv[1]); val = &val_i64; }
-        else if (strcmp(argv[2], "i32") == 0) { value_type = I32; val_i32 = atol(argv[1]); val = &val_i32; }
-        else if (strcmp(argv[2], "i16") == 0) { value_type = I16; val_i16 = atol(argv[1]); val = &val_i16; }
-        else if (strcmp(argv[2], "u64") == 0) { value_type = U64; val_u64 = atol(argv[1]); val = &val_u64; }
-        else if (strcmp(argv[2], "u32") == 0) { value_type = U32; val_u32 = atol(argv[1]); val = &val_u32; }
-        else if (strcmp(argv[2], "u16") == 0) { value_type = U16; val_u16 = atol(argv[1]); val = &val_u16; }
-        else if (strcmp(argv[2], "f64") == 0) { value_type = F64; val_f64 = atof(argv[1]); val = &val_f64; }
-        else if (strcmp(argv[2], "f32") == 0) { value_type = F32; val_f32 = atof(argv[1]); val = &val_f32; }
-        else ASSERT(0, "fatal: bad type %s\n", argv[2]);
+        ASSERT(ARGH_ARGC == 2, "usage: %s", USAGE);
+        if      (strcmp(ARGH_ARGV[1], "i64") == 0) { value_type = I64; val_i64 = atol(ARGH_ARGV[0]); val = &val_i64; }
+        else if (strcmp(ARGH_ARGV[1], "i32") == 0) { value_type = I32; val_i32 = atol(ARGH_ARGV[0]); val = &val_i32; }
+        else if (strcmp(ARGH_ARGV[1], "i16") == 0) { value_type = I16; val_i16 = atol(ARGH_ARGV[0]); val = &val_i16; }
+        else if (strcmp(ARGH_ARGV[1], "u64") == 0) { value_type = U64; val_u64 = atol(ARGH_ARGV[0]); val = &val_u64; }
+        else if (strcmp(ARGH_ARGV[1], "u32") == 0) { value_type = U32; val_u32 = atol(ARGH_ARGV[0]); val = &val_u32; }
+        else if (strcmp(ARGH_ARGV[1], "u16") == 0) { value_type = U16; val_u16 = atol(ARGH_ARGV[0]); val = &val_u16; }
+        else if (strcmp(ARGH_ARGV[1], "f64") == 0) { value_type = F64; val_f64 = atof(ARGH_ARGV[0]); val = &val_f64; }
+        else if (strcmp(ARGH_ARGV[1], "f32") == 0) { value_type = F32; val_f32 = atof(ARGH_ARGV[0]); val = &val_f32; }
+        else ASSERT(0, "fatal: bad type %s\n", ARGH_ARGV[1]);
+    }
+
+    // with an index and a seekable input, binary search for the first chunk that can hold a match. every chunk
+    // before it is taken whole, straight from disk, and rows are only checked from that chunk on.
+    if (index_path && index_seekable(stdin)) {
+        index_t index = index_load(index_path, stdin);
+        i32 chunk = index_search(&index, value_type, val);
+        i64 offset = chunk == index.size ? index.data_size : index.offsets[chunk];
+        index_copy_range(stdin, stdout, 0, offset);
+        if (chunk == index.size)
+            return 0;
+        ASSERT(0 == fseeko(stdin, offset, SEEK_SET), "fatal: failed to seek input\n");
+        done_skipping = true;
+    }
+    readbuf_t rbuf = rbuf_init((FILE*[]){stdin}, 1, false);
+
+    // with chunk stats, every chunk whose max is lt val is taken whole, straight from the input without decompressing
+    // it, and rows are only checked from the first that is not
+    u8 *raw;
+    i32 size;
+    while (!done_skipping && read_peek(&rbuf, 0) && rbuf.stats[0].type == value_type) {
+        if (compare(value_type, rbuf.stats[0].max, val) >= 0)
+            done_skipping = true;
+        else {
+            size = read_skip(&rbuf, &raw, 0);
+            FWRITE(raw, size, stdout);
+        }
     }
 
     // process input row by row
@@ -66,7 +101,7 @@ int main(int argc, char **argv) {
                 dump(&wbuf, &row, 0); // --------------------------------- otherwise dump the row
             } else if (cmp < 0) { // ------------------------------------- we aren't done skipping ahead, we want to keep skipping until we've gone too far
                 if (rabuf.has_nexted) { // ------------------------------- write the entire last chunk since we know all of it's rows are not a match
-                    memcpy(wbuf.buffer[0], rabuf.last_buffers[0], rabuf.last_chunk_size[0]);
+                    memcpy(wbuf.buffer[0], rabuf.last_chunks[0], rabuf.last_chunk_size[0]);
                     wbuf.offset[0] = rabuf.last_chunk_size[0];
                     write_flush(&wbuf, 0);
                 }
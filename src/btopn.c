@@ -4,9 +4,10 @@
 #include "array.h"
 #include "load.h"
 #include "dump.h"
+#include "keys.h"
 
-#define DESCRIPTION "accumulate the top n rows in a heap by first column value\n\n"
-#define USAGE "... | btopn N [TYPE] [-r|--reversed]\n\n"
+#define DESCRIPTION "accumulate the top n rows in a heap by first column value, or by a key like 1:i64,3:str,-2:f64 as given to bsort\n\n"
+#define USAGE "... | btopn N [TYPE|KEY] [-r|--reversed]\n\n"
 #define EXAMPLE ">> echo '\n1\n3\n2\n' | bsv | bschema a:i64 | btopn 2 i64 | bschema i64:a | csv\n3\n2\n\n"
 
 int main(int argc, char **argv) {
@@ -26,7 +27,11 @@ int main(int argc, char **argv) {
     ASSERT(isdigits(ARGH_ARGV[0]), "usage: %s", USAGE);
     i32 top_n = atol(ARGH_ARGV[0]);
     i32 value_type;
-    if (ARGH_ARGC == 1)
+    sort_keys.size = 0;
+    if (ARGH_ARGC == 2 && keys_spec(ARGH_ARGV[1])) {
+        sort_keys = keys_parse(ARGH_ARGV[1], reversed);
+        value_type = sort_keys.types[0];
+    } else if (ARGH_ARGC == 1)
         if (reversed)
             value_type = R_STR;
         else
@@ -56,42 +61,31 @@ int main(int argc, char **argv) {
         }
     }
 
+    if (!sort_keys.size)
+        sort_keys = keys_single(value_type);
+    bool composite = keys_composite(&sort_keys);
+
     // setup state
     row_t row;
     raw_row_t *raw_row;
     heap h;
-    switch (value_type) {
-        // normal
-        case STR: heap_create(&h, top_n, compare_str); break;
-        case I64: heap_create(&h, top_n, compare_i64); break;
-        case I32: heap_create(&h, top_n, compare_i32); break;
-        case I16: heap_create(&h, top_n, compare_i16); break;
-        case U64: heap_create(&h, top_n, compare_u64); break;
-        case U32: heap_create(&h, top_n, compare_u32); break;
-        case U16: heap_create(&h, top_n, compare_u16); break;
-        case F64: heap_create(&h, top_n, compare_f64); break;
-        case F32: heap_create(&h, top_n, compare_f32); break;
-        // reverse
-        case R_STR: heap_create(&h, top_n, compare_r_str); break;
-        case R_I64: heap_create(&h, top_n, compare_r_i64); break;
-        case R_I32: heap_create(&h, top_n, compare_r_i32); break;
-        case R_I16: heap_create(&h, top_n, compare_r_i16); break;
-        case R_U64: heap_create(&h, top_n, compare_r_u64); break;
-        case R_U32: heap_create(&h, top_n, compare_r_u32); break;
-        case R_U16: heap_create(&h, top_n, compare_r_u16); break;
-        case R_F64: heap_create(&h, top_n, compare_r_f64); break;
-        case R_F32: heap_create(&h, top_n, compare_r_f32); break;
-    }
+    heap_create(&h, top_n, composite ? sort_keys_compare : compare_fn(value_type));
 
-    // seed the heap with the first N rows of input
+    // seed the heap with the first N rows of input. each slot keeps its buffer for the rows that displace it.
+    raw_row_t *slots;
+    i32 *capacities;
+    MALLOC(slots, sizeof(raw_row_t) * MAX(1, top_n));
+    MALLOC(capacities, sizeof(i32) * MAX(1, top_n));
     for (i32 i = 0; i < top_n; i++) {
         load_next(&rbuf, &row, 0);
         if (row.stop)
             break;
-        ASSERT_SIZE(value_type, row.sizes[0]);
-        MALLOC(raw_row, sizeof(raw_row_t));
-        row_to_raw_malloc(&row, raw_row);
-        heap_insert(&h, raw_row->buffer, raw_row);
+        keys_check(&sort_keys, &row);
+        raw_row = &slots[i];
+        raw_row->header = NULL;
+        capacities[i] = 0;
+        row_to_raw_reuse(&row, raw_row, &capacities[i]);
+        heap_insert(&h, composite ? raw_row->header : raw_row->buffer, raw_row);
     }
     top_n = heap_size(&h);
 
@@ -100,13 +94,12 @@ int main(int argc, char **argv) {
         load_next(&rbuf, &row, 0);
         if (row.stop)
             break;
-        ASSERT_SIZE(value_type, row.sizes[0]);
+        keys_check(&sort_keys, &row);
         ASSERT(1 == heap_min(&h, NULL, &raw_row), "fatal: heap_min failed\n");
-        if (compare(value_type, row.columns[0], raw_row->buffer) > 0) {
+        if ((composite ? keys_compare(&sort_keys, keys_header(&row), raw_row->header) : compare(value_type, row.columns[0], raw_row->buffer)) > 0) {
             ASSERT(1 == heap_delmin(&h, NULL, &raw_row), "fatal: heap_delmin failed\n");
-            raw_row_free(raw_row);
-            row_to_raw_malloc(&row, raw_row);
-            heap_insert(&h, raw_row->buffer, raw_row);
+            row_to_raw_reuse(&row, raw_row, &capacities[raw_row - slots]);
+            heap_insert(&h, composite ? raw_row->header : raw_row->buffer, raw_row);
         }
     }
 
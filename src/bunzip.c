@@ -4,7 +4,7 @@
 #include "dump.h"
 
 #define DESCRIPTION "split a multi column input into single column outputs\n\n"
-#define USAGE "... | bunzip PREFIX [-l|--lz4]\n\n"
+#define USAGE "... | bunzip PREFIX [-l|--lz4] [-c CODEC|--codec CODEC] [-x|--checksum] [-w N|--writers N]\n\n"
 #define EXAMPLE ">> echo '\na,b,c\n1,2,3\n' | bsv | bunzip col && echo col_1 col_3 | bzip | csv\na,c\n1,3\n"
 
 int main(int argc, char **argv) {
@@ -24,10 +24,16 @@ int main(int argc, char **argv) {
     new.max = 0;
 
     // parse args
-    bool lz4 = false;
+    i32 codec = CODEC_NONE;
+    bool checksum = false;
+    i32 writers = 0;
     ARGH_PARSE {
         ARGH_NEXT();
-        if ARGH_BOOL("-l", "--lz4") { lz4 = true; }
+        if      ARGH_BOOL("-l", "--lz4")      { codec = CODEC_LZ4; }
+        else if ARGH_FLAG("-c", "--codec")    { codec = codec_parse(ARGH_VAL()); }
+        else if ARGH_BOOL("-x", "--checksum") { checksum = true; }
+        else if ARGH_FLAG("-w", "--writers")  { ASSERT(isdigits(ARGH_VAL()), "fatal: should have been `--writers INT`, not `--writers %s`\n", ARGH_VAL());
+                                                writers = atol(ARGH_VAL()); }
     }
     ASSERT(ARGH_ARGC == 1, "usage: %s", USAGE);
     prefix = ARGH_ARGV[0];
@@ -47,7 +53,10 @@ int main(int argc, char **argv) {
     }
 
     // setup output
-    writebuf_t wbuf = wbuf_init(files, unzip_max + 1, lz4);
+    writebuf_t wbuf = wbuf_init(files, unzip_max + 1, codec);
+    wbuf.checksum = checksum;
+    if (writers)
+        wbuf_async(&wbuf, writers);
 
     // output first row
     for (i32 i = 0; i <= unzip_max; i++) {
@@ -0,0 +1,230 @@
+#include "util.h"
+#include "argh.h"
+#include "codec.h"
+#include "stats.h"
+#include "thread.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#define DESCRIPTION "verify the checksums, compression, rows and stats of every chunk in bsv files\n\n"
+#define USAGE "bverify [-l|--lz4] [-j N|--jobs N] FILE1 ... FILEN\n\n"
+#define EXAMPLE                                                 \
+    ">> echo a,b,c | bsv | blz4 --checksum > /tmp/data\n\n"    \
+    ">> bverify /tmp/data && echo ok\n"                         \
+    "ok\n"
+
+//
+// headers are walked on the main thread, which only touches the first
+// page of each chunk, and the chunk bodies are checked on the workers,
+// so the mapping is faulted in by all of them at once.
+//
+
+typedef struct chunk_s {
+    i32 file;
+    i64 offset;
+    i32 header;
+    i32 codec;
+    u8 *stats;
+    i32 stats_size;
+    u8 *body;
+    i32 body_size;
+    u8 *checksum;
+    char *error;
+} chunk_t;
+
+chunk_t *chunks;
+i32 num_chunks = 0;
+i32 next_chunk = 0;
+pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+// walk the rows of a chunk and check that they exactly fill it
+char *verify_rows(u8 *buffer, i32 size) {
+    i32 offset = 0;
+    i32 max;
+    i32 column;
+    u8 *sizes;
+    while (offset < size) {
+        if (size - offset < sizeof(u16))
+            return "truncated row max";
+        max = FROM_UINT16(buffer + offset);
+        offset += sizeof(u16);
+        if ((max + 1) * sizeof(u16) > size - offset)
+            return "truncated row sizes";
+        sizes = buffer + offset;
+        offset += (max + 1) * sizeof(u16);
+        for (i32 i = 0; i <= max; i++) {
+            column = FROM_UINT16(sizes + i * sizeof(u16));
+            if (column + 1 > size - offset)
+                return "truncated column";
+            if (buffer[offset + column] != '\0')
+                return "column missing trailing null";
+            offset += column + 1;
+        }
+    }
+    return NULL;
+}
+
+// recompute the stats of a chunk whose rows are known to be good, and check they match what was recorded
+char *verify_stats(chunk_t *chunk, u8 *rows, i32 size, u8 *buffer) {
+    if (FROM_UINT16(chunk->stats + sizeof(i32)) >= R_STR)
+        return "bad stats type";
+    if (chunk->stats_size != stats_write(buffer, rows, size, FROM_UINT16(chunk->stats + sizeof(i32))) || memcmp(buffer, chunk->stats, chunk->stats_size) != 0)
+        return "stats mismatch";
+    return NULL;
+}
+
+char *verify_chunk(chunk_t *chunk, u8 *buffer, u8 *stats_buffer) {
+    u64 hash;
+    u64 stats_hash = chunk->stats ? XXH3_64bits(chunk->stats, chunk->stats_size) : 0;
+    i32 size = CHUNK_SIZE(chunk->header);
+    u8 *rows = chunk->body;
+    char *error;
+    if (chunk->checksum) {
+        memcpy(&hash, chunk->checksum, sizeof(u64));
+        if (hash != chunk_checksum(chunk->header, stats_hash, chunk->body, chunk->body_size))
+            return "checksum mismatch";
+    }
+    if (chunk->codec != CODEC_NONE) {
+        if (!codec_try_decompress(chunk->codec, chunk->body, chunk->body_size, buffer, size))
+            return "decompress failed";
+        rows = buffer;
+    }
+    if ((error = verify_rows(rows, size)))
+        return error;
+    if (chunk->stats)
+        return verify_stats(chunk, rows, size, stats_buffer);
+    return NULL;
+}
+
+void *verify_worker(void *arg) {
+    (void)arg;
+    u8 *buffer;
+    u8 *stats_buffer;
+    chunk_t *chunk;
+    MALLOC(buffer, BUFFER_SIZE);
+    MALLOC(stats_buffer, STATS_MAX_SIZE);
+    while (1) {
+        MUTEX_LOCK(lock);
+        chunk = next_chunk < num_chunks ? &chunks[next_chunk++] : NULL;
+        MUTEX_UNLOCK(lock);
+        if (!chunk)
+            break;
+        chunk->error = verify_chunk(chunk, buffer, stats_buffer);
+    }
+    return NULL;
+}
+
+// walk the chunk headers of a mapped file, returning an error if they do not exactly fill it
+char *walk_chunks(i32 file, u8 *map, i64 size, bool lz4, i32 *capacity) {
+    i64 offset = 0;
+    i32 header;
+    chunk_t *chunk;
+    while (offset < size) {
+        if (num_chunks == *capacity) {
+            *capacity *= 2;
+            REALLOC(chunks, sizeof(chunk_t) * *capacity);
+        }
+        chunk = &chunks[num_chunks];
+        chunk->file = file;
+        chunk->offset = offset;
+        chunk->error = NULL;
+        if (size - offset < sizeof(i32))
+            return "truncated chunk header";
+        memcpy(&header, map + offset, sizeof(i32));
+        offset += sizeof(i32);
+        if (!CHUNK_VALID(header))
+            return "bad chunk size";
+        chunk->header = header;
+        chunk->codec = CHUNK_CODEC(header);
+        if (chunk->codec == CODEC_NONE && lz4)
+            chunk->codec = CODEC_LZ4;
+        chunk->body_size = CHUNK_SIZE(header);
+        chunk->stats = NULL;
+        if (header & CHUNK_STATS) {
+            if (size - offset < STATS_HEADER_SIZE || size - offset < stats_length(map + offset))
+                return "truncated stats";
+            chunk->stats = map + offset;
+            chunk->stats_size = stats_length(map + offset);
+            offset += chunk->stats_size;
+        }
+        if (chunk->codec != CODEC_NONE) {
+            if (size - offset < sizeof(i32))
+                return "truncated compressed size";
+            memcpy(&chunk->body_size, map + offset, sizeof(i32));
+            offset += sizeof(i32);
+            if (chunk->body_size < 0 || chunk->body_size > BUFFER_SIZE_LZ4)
+                return "bad compressed chunk size";
+        }
+        if (size - offset < chunk->body_size)
+            return "truncated chunk";
+        chunk->body = map + offset;
+        offset += chunk->body_size;
+        chunk->checksum = NULL;
+        if (header & CHUNK_CHECKSUM) {
+            if (size - offset < sizeof(u64))
+                return "truncated checksum";
+            chunk->checksum = map + offset;
+            offset += sizeof(u64);
+        }
+        num_chunks++;
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+
+    // setup bsv
+    SETUP();
+
+    // parse args
+    bool lz4 = false;
+    i32 jobs = 1;
+    ARGH_PARSE {
+        ARGH_NEXT();
+        if      ARGH_BOOL("-l", "--lz4")  { lz4 = true; }
+        else if ARGH_FLAG("-j", "--jobs") { ASSERT(isdigits(ARGH_VAL()), "fatal: should have been `--jobs INT`, not `--jobs %s`\n", ARGH_VAL());
+                                            jobs = atol(ARGH_VAL()); }
+    }
+    ASSERT(ARGH_ARGC > 0, "usage: %s", USAGE);
+    ASSERT(jobs > 0, "fatal: number of jobs must be positive, got: %d\n", jobs);
+
+    // map every file and walk its chunk headers
+    i32 capacity = 1024;
+    i32 failed = 0;
+    char *error;
+    struct stat st;
+    MALLOC(chunks, sizeof(chunk_t) * capacity);
+    for (i32 i = 0; i < ARGH_ARGC; i++) {
+        i32 fd = open(ARGH_ARGV[i], O_RDONLY);
+        ASSERT(fd >= 0, "fatal: failed to open: %s\n", ARGH_ARGV[i]);
+        ASSERT(0 == fstat(fd, &st) && S_ISREG(st.st_mode), "fatal: not a regular file: %s\n", ARGH_ARGV[i]);
+        if (st.st_size == 0)
+            continue;
+        u8 *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ASSERT(map != MAP_FAILED, "fatal: failed to mmap: %s\n", ARGH_ARGV[i]);
+        close(fd);
+        madvise(map, st.st_size, MADV_WILLNEED);
+        error = walk_chunks(i, map, st.st_size, lz4, &capacity);
+        if (error) {
+            FPRINTF(stderr, "%s: chunk at offset %ld: %s\n", ARGH_ARGV[i], chunks[num_chunks].offset, error);
+            failed = 1;
+        }
+    }
+
+    // check chunk bodies on the workers
+    pthread_t workers[jobs];
+    for (i32 i = 0; i < jobs; i++)
+        THREAD_CREATE(workers[i], verify_worker, NULL);
+    for (i32 i = 0; i < jobs; i++)
+        THREAD_JOIN(workers[i]);
+
+    // report bad chunks in file order
+    for (i32 i = 0; i < num_chunks; i++) {
+        if (chunks[i].error) {
+            FPRINTF(stderr, "%s: chunk at offset %ld: %s\n", ARGH_ARGV[chunks[i].file], chunks[i].offset, chunks[i].error);
+            failed = 1;
+        }
+    }
+    return failed;
+}
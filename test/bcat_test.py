@@ -8,7 +8,7 @@ def setup_module(m):
     m.path = os.environ['PATH']
     os.chdir(m.tempdir)
     os.environ['PATH'] = f'{os.getcwd()}/bin:/usr/bin:/usr/local/bin:/sbin:/usr/sbin:/bin'
-    shell.run('make clean && make bsv csv bcat', stream=True)
+    shell.run('make clean && make bsv csv bcat blz4', stream=True)
 
 def teardown_module(m):
     os.chdir(m.orig)
@@ -51,3 +51,16 @@ def test_basic():
         c
         """
         assert rm_whitespace(unindent(stdout)) == shell.run('bcat a b c')
+
+def test_codec_detected():
+    with shell.tempdir():
+        shell.run('echo a | bsv > a')
+        shell.run('echo b | bsv | blz4 > b')
+        shell.run('echo c | bsv | blz4 -c lz4:8 > c')
+        stdout = """
+        a:a
+        b:b
+        c:c
+        """
+        assert rm_whitespace(unindent(stdout)) == shell.run('bcat --prefix a b c')
+        assert 'b' == shell.run('cat b | bcat /dev/stdin')
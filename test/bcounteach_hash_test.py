@@ -61,6 +61,13 @@ def test_props(args):
     result = expected(csv)
     assert result == run(csv, f'bsv.{buffer} | bcounteach-hash.{buffer} | bschema.{buffer} *,i64:a | bsort.{buffer} | csv.{buffer}')
 
+@given(inputs())
+@settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), suppress_health_check=HealthCheck.all()) # type: ignore
+def test_props_jobs(args):
+    buffer, csv = args
+    result = expected(csv)
+    assert result == run(csv, f'bsv.{buffer} | bcounteach-hash.{buffer} --jobs 3 | bschema.{buffer} *,i64:a | bsort.{buffer} | csv.{buffer}')
+
 def test_basic():
     stdin = """
     a
@@ -75,3 +82,20 @@ def test_basic():
     b,2
     """
     assert rm_whitespace(stdout) + '\n' == run(rm_whitespace(stdin), 'bsv | bcounteach-hash | bschema *,i64:a | bsort | csv')
+
+def test_grows():
+    keys = [f'k{i}' for i in range(100000)]
+    csv = '\n'.join(keys + keys[::3]) + '\n'
+    assert expected(csv) == run(csv, 'bsv | bcounteach-hash | bschema *,i64:a | bsort | csv')
+
+def test_spills():
+    keys = [f'k{i}' for i in range(100000)]
+    csv = '\n'.join(keys + keys[::3]) + '\n'
+    assert expected(csv) == run(csv, 'bsv | bcounteach-hash --memory-limit 2M | bschema *,i64:a | bsort | csv')
+    buffer = buffers[0] # spill chunks must fit a small BUFFER_SIZE too
+    assert expected(csv) == run(csv, f'bsv.{buffer} | bcounteach-hash.{buffer} --memory-limit 2M | bschema.{buffer} *,i64:a | bsort.{buffer} | csv.{buffer}')
+
+def test_jobs_grows():
+    keys = [f'k{i}' for i in range(100000)]
+    csv = '\n'.join(keys + keys[::3]) + '\n'
+    assert expected(csv) == run(csv, 'bsv | bcounteach-hash -j 4 | bschema *,i64:a | bsort | csv')
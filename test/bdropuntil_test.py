@@ -23,7 +23,9 @@ def setup_module(m):
     compile_buffer_sizes('bsv', buffers)
     compile_buffer_sizes('bsort', buffers)
     compile_buffer_sizes('bdropuntil', buffers)
-    shell.run('make bsv csv bsort bdropuntil', stream=True)
+    compile_buffer_sizes('bindex', buffers)
+    compile_buffer_sizes('blz4', buffers)
+    shell.run('make bsv csv bsort bdropuntil bindex blz4', stream=True)
 
 def teardown_module(m):
     os.chdir(m.orig)
@@ -81,6 +83,21 @@ def test_props(args):
     result = expected(value, csv)
     assert set(result.splitlines()) == set(run(csv, f'bsv.{buffer} | bsort.{buffer} | bdropuntil.{buffer} "{value}" | csv.{buffer}').splitlines()) # set because sort is not stable and is only for first column values
 
+@given(inputs())
+@settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
+def test_props_index(args):
+    value, csv, buffer = args
+    result = expected(value, csv)
+    assert set(result.splitlines()) == set(run(csv, f'bsv.{buffer} | bsort.{buffer} --index data.bsort.idx > data && bindex.{buffer} data && cmp data.bsort.idx data.idx && bdropuntil.{buffer} "{value}" --index data.idx < data | csv.{buffer}').splitlines())
+
+@given(inputs())
+@settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
+def test_props_stats(args):
+    value, csv, buffer = args
+    result = expected(value, csv)
+    assert set(result.splitlines()) == set(run(csv, f'bsv.{buffer} | bsort.{buffer} --stats > data && bdropuntil.{buffer} "{value}" < data | csv.{buffer}').splitlines())
+    assert set(result.splitlines()) == set(run(csv, f'bsv.{buffer} | bsort.{buffer} --stats | blz4.{buffer} | bdropuntil.{buffer} "{value}" | csv.{buffer}').splitlines())
+
 def test_example1():
     value, csv = 'g', 'a\nb\nc\nd\ne\nf\ng\nh\n'
     result = expected(value, csv)
@@ -100,3 +117,15 @@ def test_example4():
     value, csv = 'b', 'a\na\na\nb\n'
     result = expected(value, csv)
     assert result == run(csv, f'bsv 2>/dev/null | bsort | bdropuntil "{value}" | csv 2>/dev/null')
+
+def test_index_append():
+    with shell.climb_git_root():
+        with shell.tempdir():
+            shell.run('echo -e "x\ny\nz\n" | bsv > data')
+            shell.run('echo -e "a\nb\nc\n" | bsv | bsort --index data.idx >> data')
+            assert 'b\nc' == shell.run('bdropuntil b --index data.idx < data | csv')
+            res = shell.run('{ echo; echo a | bsv | bsort --index data.idx; } > data', warn=True)
+            assert 'fatal: cannot index output that does not start at offset 0' == res['stderr']
+            shell.run('echo -e "a\nb\nc\n" | bsv | bsort --index data.idx > data && echo d | bsv >> data && touch data.idx')
+            res = shell.run('bdropuntil b --index data.idx < data', warn=True)
+            assert 'fatal: index does not match its input: data.idx' == res['stderr']
@@ -0,0 +1,82 @@
+import os
+import string
+import shell
+from hypothesis.database import ExampleDatabase
+from hypothesis import given, settings
+from hypothesis.strategies import text, lists, composite, integers, sampled_from
+from test_util import rm_whitespace, unindent, clone_source
+
+def setup_module(m):
+    m.tempdir = clone_source()
+    m.orig = os.getcwd()
+    m.path = os.environ['PATH']
+    os.chdir(m.tempdir)
+    os.environ['PATH'] = f'{os.getcwd()}/bin:/usr/bin:/usr/local/bin:/sbin:/usr/sbin:/bin'
+    shell.run('make clean && make bsv csv blz4 bjoin-hash', stream=True)
+
+def teardown_module(m):
+    os.chdir(m.orig)
+    os.environ['PATH'] = m.path
+    assert m.tempdir.startswith('/tmp/') or m.tempdir.startswith('/private/var/folders/')
+    shell.run('rm -rf', m.tempdir)
+
+@composite
+def inputs(draw):
+    key = sampled_from('abcdefg')
+    column = text(string.ascii_lowercase, min_size=1, max_size=4)
+    sides = []
+    for _ in range(2):
+        num_columns = draw(integers(min_value=0, max_value=2))
+        line = lists(column, min_size=num_columns, max_size=num_columns)
+        rows = draw(lists(lists(key, min_size=1, max_size=1), min_size=1))
+        sides.append([k + draw(line) for k in rows])
+    return sides
+
+def expected(big, small, join):
+    result = []
+    for b in big:
+        matches = [s for s in small if s[0] == b[0]]
+        if join == 'anti':
+            if not matches:
+                result.append(b)
+        elif matches:
+            for s in matches:
+                result.append(b + s[1:])
+        elif join == 'left':
+            result.append(b)
+    return '\n'.join(','.join(x) for x in result)
+
+@given(inputs(), sampled_from(['inner', 'left', 'anti']))
+@settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
+def test_props(sides, join):
+    big, small = sides
+    flag = {'inner': '', 'left': '--left', 'anti': '--anti'}[join]
+    with shell.tempdir():
+        shell.run('bsv > big.bsv', stdin='\n'.join(','.join(x) for x in big) + '\n')
+        shell.run('bsv > small.bsv', stdin='\n'.join(','.join(x) for x in small) + '\n')
+        assert expected(big, small, join) == shell.run(f'cat big.bsv | bjoin-hash {flag} small.bsv | csv', echo=True)
+        shell.run('blz4 < big.bsv > big.lz4')
+        shell.run('blz4 < small.bsv > small.lz4')
+        assert expected(big, small, join) == shell.run(f'cat big.lz4 | bjoin-hash {flag} -l small.lz4 | csv')
+
+def test_basic():
+    with shell.tempdir():
+        shell.run('echo -e "a,x\nc,y\nc,z\n" | bsv > small.bsv')
+        stdout = """
+        c,3,y
+        c,3,z
+        b,2
+        a,1,x
+        """
+        assert rm_whitespace(unindent(stdout)) == shell.run('echo -e "c,3\nb,2\na,1\n" | bsv | bjoin-hash --left small.bsv | csv', stream=True)
+
+def test_memory_limit():
+    with shell.tempdir():
+        shell.run('echo -e "a,x\nc,y\nc,z\n" | bsv > small.bsv')
+        assert 'a,1,x' == shell.run('echo a,1 | bsv | bjoin-hash -m 64M small.bsv | csv')
+        res = shell.run('echo a,1 | bsv | bjoin-hash -m 1K small.bsv', warn=True)
+        assert res['stderr'].startswith('fatal: --memory-limit must be at least')
+        assert 'a,1,x' == shell.run('echo a,1 | bsv | bjoin-hash -m 2M small.bsv | csv')
+        shell.run('seq 1 100000 | sed s/$/,xxxxxxxxxxxxxxxx/ | bsv > big.bsv')
+        res = shell.run('echo a,1 | bsv | bjoin-hash -m 2M big.bsv', warn=True)
+        assert res['stderr'].startswith('fatal: big.bsv needs more than --memory-limit')
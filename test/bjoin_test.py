@@ -0,0 +1,129 @@
+import os
+import string
+import shell
+import random
+from hypothesis.database import ExampleDatabase
+from hypothesis import given, settings
+from hypothesis.strategies import text, lists, composite, integers, sampled_from
+from test_util import rm_whitespace, unindent, clone_source, compile_buffer_sizes
+
+if os.environ.get('TEST_FACTOR'):
+    buffers = list(sorted(set([128, 256, 1024, 1024 * 1024 * 5] + [random.randint(128, 1024) for _ in range(10)])))
+else:
+    buffers = [128]
+
+def setup_module(m):
+    m.tempdir = clone_source()
+    m.orig = os.getcwd()
+    m.path = os.environ['PATH']
+    os.chdir(m.tempdir)
+    os.environ['PATH'] = f'{os.getcwd()}/bin:/usr/bin:/usr/local/bin:/sbin:/usr/sbin:/bin'
+    shell.run('make clean', stream=True)
+    compile_buffer_sizes('csv', buffers)
+    compile_buffer_sizes('bsv', buffers)
+    compile_buffer_sizes('bjoin', buffers)
+    shell.run('make bsv csv bschema blz4 bjoin', stream=True)
+
+def teardown_module(m):
+    os.chdir(m.orig)
+    os.environ['PATH'] = m.path
+    assert m.tempdir.startswith('/tmp/') or m.tempdir.startswith('/private/var/folders/')
+    shell.run('rm -rf', m.tempdir)
+
+@composite
+def inputs(draw):
+    key = sampled_from('abcdefg')
+    column = text(string.ascii_lowercase, min_size=1, max_size=4)
+    sides = []
+    for _ in range(2):
+        num_columns = draw(integers(min_value=0, max_value=2))
+        line = lists(column, min_size=num_columns, max_size=num_columns)
+        rows = draw(lists(lists(key, min_size=1, max_size=1), min_size=1))
+        rows = sorted([k + draw(line) for k in rows], key=lambda x: x[0])
+        sides.append(rows)
+    return sides
+
+def expected(left, right, join):
+    result = []
+    for l in left:
+        matches = [r for r in right if r[0] == l[0]]
+        if join == 'anti':
+            if not matches:
+                result.append(l)
+        elif matches:
+            for r in matches:
+                result.append(l + r[1:])
+        elif join == 'left':
+            result.append(l)
+    return '\n'.join(','.join(x) for x in result)
+
+@given(inputs(), sampled_from(['inner', 'left', 'anti']))
+@settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
+def test_props(sides, join):
+    left, right = sides
+    flag = {'inner': '', 'left': '--left', 'anti': '--anti'}[join]
+    with shell.tempdir():
+        shell.run('bsv > left.bsv', stdin='\n'.join(','.join(x) for x in left) + '\n')
+        shell.run('bsv > right.bsv', stdin='\n'.join(','.join(x) for x in right) + '\n')
+        assert expected(left, right, join) == shell.run(f'bjoin {flag} left.bsv right.bsv | csv', echo=True)
+        shell.run('blz4 < left.bsv > left.lz4')
+        shell.run('blz4 < right.bsv > right.lz4')
+        assert expected(left, right, join) == shell.run(f'bjoin {flag} -l left.lz4 right.lz4 | csv')
+
+@given(inputs(), sampled_from(['inner', 'left', 'anti']), sampled_from(buffers))
+@settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
+def test_props_buffers(sides, join, buffer):
+    left, right = sides
+    flag = {'inner': '', 'left': '--left', 'anti': '--anti'}[join]
+    with shell.tempdir():
+        shell.run(f'bsv.{buffer} > left.bsv', stdin='\n'.join(','.join(x) for x in left) + '\n')
+        shell.run(f'bsv.{buffer} > right.bsv', stdin='\n'.join(','.join(x) for x in right) + '\n')
+        assert expected(left, right, join) == shell.run(f'bjoin.{buffer} {flag} -T . left.bsv right.bsv | csv.{buffer}', echo=True)
+
+def test_spills():
+    buffer = buffers[0]
+    left = [['a', str(i)] for i in range(3)] + [['b', 'x']]
+    right = [['a', f'v{i}'] for i in range(200)] + [['b', 'y']]
+    with shell.tempdir():
+        shell.run(f'bsv.{buffer} > left.bsv', stdin='\n'.join(','.join(x) for x in left) + '\n')
+        shell.run(f'bsv.{buffer} > right.bsv', stdin='\n'.join(','.join(x) for x in right) + '\n')
+        assert os.path.getsize('right.bsv') > buffer * 8 # the run of a spans many buffers, so it spills to a temp file
+        assert expected(left, right, 'inner') == shell.run(f'bjoin.{buffer} -T . left.bsv right.bsv | csv.{buffer}')
+
+def test_basic():
+    with shell.tempdir():
+        shell.run('echo -e "a,1\nb,2\nc,3\nc,4\nd,5\n" | bsv > left.bsv')
+        shell.run('echo -e "a,x\nc,y\nc,z\ne,w\n" | bsv > right.bsv')
+        stdout = """
+        a,1,x
+        c,3,y
+        c,3,z
+        c,4,y
+        c,4,z
+        """
+        assert rm_whitespace(unindent(stdout)) == shell.run('bjoin left.bsv right.bsv | csv', stream=True)
+        stdout = """
+        a,1,x
+        b,2
+        c,3,y
+        c,3,z
+        c,4,y
+        c,4,z
+        d,5
+        """
+        assert rm_whitespace(unindent(stdout)) == shell.run('bjoin --left left.bsv right.bsv | csv', stream=True)
+        stdout = """
+        b,2
+        d,5
+        """
+        assert rm_whitespace(unindent(stdout)) == shell.run('bjoin --anti left.bsv right.bsv | csv', stream=True)
+
+def test_types():
+    with shell.tempdir():
+        shell.run('echo -e "3,a\n2,b\n1,c\n" | bsv | bschema a:i64,* > left.bsv')
+        shell.run('echo -e "3,x\n1,y\n" | bsv | bschema a:i64,* > right.bsv')
+        stdout = """
+        3,a,x
+        1,c,y
+        """
+        assert rm_whitespace(unindent(stdout)) == shell.run('bjoin i64 -r left.bsv right.bsv | bschema i64:a,*,* | csv', stream=True)
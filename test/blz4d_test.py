@@ -18,11 +18,12 @@ def setup_module(m):
     m.path = os.environ['PATH']
     os.chdir(m.tempdir)
     os.environ['PATH'] = f'{os.getcwd()}/bin:/usr/bin:/usr/local/bin:/sbin:/usr/sbin:/bin'
-    shell.run('make clean && make bsv csv blz4 blz4d', stream=True)
+    shell.run('make clean', stream=True)
     compile_buffer_sizes('csv', buffers)
     compile_buffer_sizes('bsv', buffers)
     compile_buffer_sizes('blz4', buffers)
     compile_buffer_sizes('blz4d', buffers)
+    shell.run('make bsv csv blz4 blz4d bpartition xxh3', stream=True)
 
 def teardown_module(m):
     os.chdir(m.orig)
@@ -45,3 +46,12 @@ def inputs(draw):
 def test_props(args):
     buffer, csv = args
     assert csv == shell.run(f'bsv.{buffer} | blz4.{buffer} | blz4d.{buffer} | csv.{buffer}', stdin=csv)
+    assert csv == shell.run(f'bsv.{buffer} | blz4.{buffer} -j 3 | blz4d.{buffer} --jobs 2 | csv.{buffer}', stdin=csv)
+    assert shell.run(f'bsv.{buffer} | blz4.{buffer} | xxh3', stdin=csv) == shell.run(f'bsv.{buffer} | blz4.{buffer} -j 4 | xxh3', stdin=csv)
+
+def test_checksummed_input():
+    with shell.tempdir():
+        shell.run('echo -e "a,b\nc,d\n" | bsv | bpartition --checksum 1 part')
+        assert 'a,b\nc,d' == shell.run('blz4 < part_0 | blz4d | csv')
+        assert shell.run('echo -e "a,b\nc,d\n" | bsv | blz4 | xxh3') == shell.run('blz4 < part_0 | xxh3') # the checksum is only written again with --checksum
+        assert shell.run('echo -e "a,b\nc,d\n" | bsv | blz4 -x | xxh3') == shell.run('blz4 -x < part_0 | xxh3')
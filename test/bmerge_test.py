@@ -1,4 +1,5 @@
 import os
+import random
 import string
 import shell
 from hypothesis.database import ExampleDatabase
@@ -7,7 +8,7 @@ from hypothesis.strategies import text, lists, composite, integers
 from test_util import rm_whitespace, clone_source
 import os
 import shell
-from test_util import unindent, rm_whitespace, clone_source
+from test_util import unindent, rm_whitespace, clone_source, compile_buffer_sizes
 
 def setup_module(m):
     m.tempdir = clone_source()
@@ -15,7 +16,10 @@ def setup_module(m):
     m.path = os.environ['PATH']
     os.chdir(m.tempdir)
     os.environ['PATH'] = f'{os.getcwd()}/bin:/usr/bin:/usr/local/bin:/sbin:/usr/sbin:/bin'
-    shell.run('make clean && make bsv csv bsort bcut bmerge', stream=True)
+    shell.run('make clean', stream=True)
+    compile_buffer_sizes('bsv', [128])
+    compile_buffer_sizes('bsort', [128])
+    shell.run('make bsv csv bsort bcut bmerge blz4 bschema bsumeach bcounteach bdedupe bindex', stream=True)
 
 def teardown_module(m):
     os.chdir(m.orig)
@@ -58,6 +62,29 @@ def test_basic():
         assert rm_whitespace(unindent(stdout)) == shell.run('(echo a.bsv; echo b.bsv) | bmerge | csv', stream=True)
         assert rm_whitespace(unindent(stdout)) == shell.run('(echo a.bsv; echo; echo b.bsv) | bmerge | csv', stream=True)
 
+def test_composite():
+    with shell.tempdir():
+        shell.run('echo -e "a,1\nb,1\na,2\n" | bsv > a.bsv')
+        shell.run('echo -e "c,1\nb,2\nc,2\n" | bsv > b.bsv')
+        stdout = """
+        a,1
+        b,1
+        c,1
+        a,2
+        b,2
+        c,2
+        """
+        assert rm_whitespace(unindent(stdout)) == shell.run('echo a.bsv b.bsv | bmerge 2:str,1:str | csv', stream=True)
+
+def test_aggregates():
+    with shell.tempdir():
+        shell.run('echo -e "a,1\nb,2\nb,3\n" | bsv | bschema *,a:i64 > a.bsv')
+        shell.run('echo -e "a,4\nc,5\n" | bsv | bschema *,a:i64 > b.bsv')
+        assert 'a,5\nb,5\nc,5' == shell.run('echo a.bsv b.bsv | bmerge --sum i64 | bschema *,i64:a | csv', stream=True)
+        assert 'a,2\nb,2\nc,1' == shell.run('echo a.bsv b.bsv | bmerge --count | bschema *,i64:a | csv', stream=True)
+        assert 'a,1\nb,2\nc,5' == shell.run('echo a.bsv b.bsv | bmerge --dedupe | bschema *,i64:a | csv', stream=True)
+        assert 'a,5\nb,5\nc,5' == shell.run('echo a.bsv b.bsv | bmerge -S i64 -j 2 | bschema *,i64:a | csv', stream=True)
+
 @composite
 def inputs(draw):
     num_inputs = draw(integers(min_value=1, max_value=8))
@@ -92,6 +119,21 @@ def test_props(csvs):
             assert result.strip() == shell.run('echo', *paths, '| bmerge | bcut 1 | csv', echo=True)
             assert shell.run('cat', *paths, '| bsort | bcut 1 | csv') == shell.run('echo', *paths, '| bmerge | bcut 1 | csv')
 
+@given(inputs())
+@settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
+def test_props_lz4_prefetch(csvs):
+    result = expected(csvs)
+    if result.strip():
+        with shell.tempdir():
+            paths = []
+            for i, csv in enumerate(csvs):
+                path = f'file{i}.bsv'
+                shell.run(f'bsv | blz4 > {path}', stdin=csv)
+                paths.append(path)
+            assert result.strip() == shell.run('echo', *paths, '| bmerge --lz4 --prefetch 2 | bcut 1 | csv', echo=True)
+            assert result.strip() == shell.run('echo', *paths, '| bmerge -l -P 1 | bcut 1 | csv')
+            assert result.strip() == shell.run('echo', *paths, '| bmerge --prefetch 2 | bcut 1 | csv') # tagged chunks are prefetched without --lz4 too
+
 @given(inputs())
 @settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
 def test_props_compatability(csvs):
@@ -109,3 +151,52 @@ def test_props_compatability(csvs):
                 shell.run(f'cat - > {path}', stdin=csv)
                 csv_paths.append(path)
             assert shell.run('LC_ALL=C sort -m -k1,1', *csv_paths, ' | cut -d, -f1 | grep -v ^$') == shell.run('echo', *bsv_paths, '| bmerge | bcut 1 | csv', echo=True)
+
+@given(inputs())
+@settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
+def test_props_jobs(csvs):
+    result = expected(csvs)
+    if result.strip():
+        with shell.tempdir():
+            paths = []
+            for i, csv in enumerate(csvs):
+                path = f'file{i}.bsv'
+                shell.run(f'bsv > {path}', stdin=csv)
+                paths.append(path)
+            assert shell.run('echo', *paths, '| bmerge | csv') == shell.run('echo', *paths, '| bmerge --jobs 3 | csv', echo=True)
+            assert shell.run('echo', *paths, '| bmerge | csv') == shell.run('echo', *paths, '| bmerge -j 2 -T . | csv')
+            for path in paths:
+                shell.run(f'cat {path} | blz4 > {path}.lz4')
+            assert shell.run('echo', *paths, '| bmerge | csv') == shell.run('echo', *[f'{path}.lz4' for path in paths], '| bmerge -l -j 4 | csv')
+
+def test_jobs_samples():
+    with shell.tempdir():
+        r = random.Random(0)
+        for i in range(4):
+            csv = ''.join(f'{r.randint(0, 10 ** 6)},{r.choice(string.ascii_lowercase)}\n' for _ in range(2000))
+            shell.run(f'bsv.128 | bsort.128 > plain{i}.bsv', stdin=csv)
+            shell.run(f'bsv.128 | bsort.128 -s > stats{i}.bsv', stdin=csv)
+            shell.run(f'bsv.128 | bsort.128 > indexed{i}.bsv', stdin=csv)
+            shell.run(f'bindex indexed{i}.bsv')
+            shell.run(f'bsv.128 | bsort.128 2:str,1:str > composite{i}.bsv', stdin=csv)
+        for kind in ['plain', 'stats', 'indexed']:
+            paths = [f'{kind}{i}.bsv' for i in range(4)]
+            for jobs in [2, 3, 8]:
+                assert shell.run('echo', *paths, '| bmerge | csv') == shell.run('echo', *paths, f'| bmerge -j {jobs} | csv')
+        paths = [f'composite{i}.bsv' for i in range(4)]
+        assert shell.run('echo', *paths, '| bmerge 2:str,1:str | csv') == shell.run('echo', *paths, '| bmerge 2:str,1:str -j 3 | csv')
+
+@given(inputs())
+@settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
+def test_props_aggregates(csvs):
+    result = expected(csvs)
+    if result.strip():
+        with shell.tempdir():
+            paths = []
+            for i, csv in enumerate(csvs):
+                path = f'file{i}.bsv'
+                shell.run(f'bsv > {path}', stdin=csv)
+                paths.append(path)
+            assert shell.run('echo', *paths, '| bmerge | bcounteach | bschema *,i64:a | csv') == shell.run('echo', *paths, '| bmerge --count | bschema *,i64:a | csv', echo=True)
+            assert shell.run('echo', *paths, '| bmerge | bdedupe | csv') == shell.run('echo', *paths, '| bmerge --dedupe | csv')
+            assert shell.run('echo', *paths, '| bmerge | bdedupe | csv') == shell.run('echo', *paths, '| bmerge -d -j 3 | csv')
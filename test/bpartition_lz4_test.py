@@ -55,6 +55,16 @@ def test_props(args):
         assert stdout == shell.run(f'bsv | bpartition -l {num_buckets} prefix', stdin=csv, echo=True)
         assert result == shell.run('bcat -l -p prefix*')
 
+@given(inputs())
+@settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
+def test_props_writers(args):
+    num_buckets, csv = args
+    result = expected(num_buckets, csv)
+    with shell.tempdir():
+        stdout = '\n'.join(sorted({l.split(':')[0] for l in result.splitlines()}))
+        assert stdout == shell.run(f'bsv | bpartition -l -w 3 {num_buckets} prefix', stdin=csv, echo=True)
+        assert result == shell.run('bcat -l -p prefix*')
+
 def test_without_prefix():
     with shell.tempdir():
         stdin = """
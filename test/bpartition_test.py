@@ -1,6 +1,8 @@
 import os
+import struct
 import string
 import shell
+import bisect
 import collections
 import xxh3
 from hypothesis.database import ExampleDatabase
@@ -14,7 +16,7 @@ def setup_module(m):
     m.path = os.environ['PATH']
     os.chdir(m.tempdir)
     os.environ['PATH'] = f'{os.getcwd()}/bin:/usr/bin:/usr/local/bin:/sbin:/usr/sbin:/bin'
-    shell.run('make clean && make bsv csv bcat bpartition', stream=True)
+    shell.run('make clean && make bsv csv bcat bpartition bschema', stream=True)
 
 def teardown_module(m):
     os.chdir(m.orig)
@@ -45,6 +47,25 @@ def expected(num_buckets, csv):
             val += f'prefix_{k}:{line}\n'
     return val.strip()
 
+@composite
+def range_inputs(draw):
+    _, csv = draw(inputs())
+    splitters = sorted(draw(lists(text(string.ascii_lowercase, min_size=1), max_size=16)))
+    return splitters, csv
+
+def expected_range(splitters, csv):
+    res = collections.defaultdict(list)
+    size = len(str(len(splitters) + 1))
+    for line in csv.splitlines():
+        col0 = line.split(',', 1)[0]
+        bucket = bisect.bisect_right(splitters, col0)
+        res[str(bucket).zfill(size)].append(line)
+    val = ''
+    for k in sorted(res):
+        for line in res[k]:
+            val += f'prefix_{k}:{line}\n'
+    return val.strip()
+
 @given(inputs())
 @settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
 def test_props(args):
@@ -55,6 +76,76 @@ def test_props(args):
         assert stdout == shell.run(f'bsv | bpartition {num_buckets} prefix', stdin=csv, echo=True)
         assert result == shell.run('bcat --prefix prefix*')
 
+@given(inputs())
+@settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
+def test_props_jobs(args):
+    num_buckets, csv = args
+    result = expected(num_buckets, csv)
+    with shell.tempdir():
+        stdout = '\n'.join(sorted({l.split(':')[0] for l in result.splitlines()}))
+        assert stdout == shell.run(f'bsv | bpartition --jobs 3 {num_buckets} prefix', stdin=csv, echo=True)
+        assert result == shell.run('bcat --prefix prefix*')
+
+@given(inputs())
+@settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
+def test_props_memory_limit(args):
+    num_buckets, csv = args
+    result = expected(num_buckets, csv)
+    with shell.tempdir():
+        stdout = '\n'.join(sorted({l.split(':')[0] for l in result.splitlines()}))
+        assert stdout == shell.run(f'ulimit -n 16; bsv | bpartition --memory-limit 8K {num_buckets} prefix', stdin=csv, echo=True)
+        assert result == shell.run('bcat --prefix prefix*')
+
+@given(range_inputs())
+@settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
+def test_props_range_splitters(args):
+    splitters, csv = args
+    result = expected_range(splitters, csv)
+    with shell.tempdir():
+        shell.run('bsv > splitters.bsv', stdin='\n'.join(splitters) + '\n')
+        stdout = '\n'.join(sorted({l.split(':')[0] for l in result.splitlines()}))
+        assert stdout == shell.run(f'bsv | bpartition --range str --splitters splitters.bsv {len(splitters) + 1} prefix', stdin=csv, echo=True)
+        assert result == shell.run('bcat --prefix prefix*')
+
+@given(inputs())
+@settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
+def test_props_range_sampled(args):
+    num_buckets, csv = args
+    with shell.tempdir():
+        shell.run('bsv > input.bsv', stdin=csv)
+        paths = shell.run(f'bpartition --range str {num_buckets} prefix < input.bsv').split()
+        buckets = [[l.split(',', 1)[0] for l in shell.run(f'bcat {path}').splitlines()] for path in paths]
+        assert sorted(csv.splitlines()) == sorted(l for path in paths for l in shell.run(f'bcat {path}').splitlines())
+        for lo, hi in zip(buckets, buckets[1:]):
+            assert max(lo) < min(hi)
+
+def test_range_i64():
+    with shell.tempdir():
+        shell.run('bsv | bschema a:i64 > splitters.bsv', stdin='-5\n10\n')
+        stdout = """
+        prefix_0
+        prefix_1
+        prefix_2
+        """
+        assert rm_whitespace(unindent(stdout)) == shell.run('echo -e "-7\n10\n3\n-5\n99\n" | bsv | bschema a:i64 | bpartition -R i64 -S splitters.bsv 3 prefix')
+        stdout = """
+        prefix_0:-7
+        prefix_1:3
+        prefix_1:-5
+        prefix_2:10
+        prefix_2:99
+        """
+        assert unindent(stdout).strip() == shell.run('for f in prefix_*; do bschema i64:a < $f | csv | sed "s/^/$f:/"; done')
+
+def test_range_i64_stats():
+    with shell.tempdir():
+        shell.run('echo -e "-7\n10\n3\n-5\n99\n" | bsv | bschema a:i64 > data.bsv')
+        shell.run('bpartition --range i64 --stats 2 prefix < data.bsv')
+        for path in ['prefix_0', 'prefix_1']:
+            with open(path, 'rb') as f:
+                data = f.read()
+            assert struct.unpack('<H', data[8:10])[0] == 1 # the stats type follows the chunk header and row count, and i64 is 1
+
 def test_without_prefix():
     with shell.tempdir():
         stdin = """
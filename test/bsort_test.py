@@ -4,7 +4,7 @@ import string
 import shell
 from hypothesis.database import ExampleDatabase
 from hypothesis import given, settings
-from hypothesis.strategies import text, lists, composite, integers
+from hypothesis.strategies import text, lists, composite, integers, tuples
 from test_util import run, rm_whitespace, clone_source
 
 def setup_module(m):
@@ -51,6 +51,33 @@ def test_props(csv):
 def test_props_compatability(csv):
     assert run(csv, 'LC_ALL=C sort -k1,1 | cut -d, -f1') == run(csv, 'bsv | bsort | bcut 1 | csv')
 
+@given(inputs())
+@settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
+def test_props_jobs(csv):
+    if expected(csv):
+        assert run(csv, 'bsv | bsort | bcut 1 | csv') == run(csv, 'bsv | bsort -j 3 | bcut 1 | csv')
+
+@given(inputs())
+@settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
+def test_props_memory_limit(csv):
+    if expected(csv):
+        assert run(csv, 'bsv | bsort | bcut 1 | csv') == run(csv, 'bsv | bsort --memory-limit 1 --tmpdir . | bcut 1 | csv')
+
+@composite
+def composite_inputs(draw):
+    num_rows = draw(integers(min_value=1, max_value=64))
+    row = tuples(text(string.ascii_lowercase, min_size=1, max_size=4), integers(min_value=-4, max_value=4))
+    return draw(lists(row, min_size=num_rows, max_size=num_rows))
+
+@given(composite_inputs())
+@settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
+def test_props_composite(rows):
+    csv = ''.join(f'{a},{b}\n' for a, b in rows)
+    rows = sorted(rows, key=lambda x: x[0], reverse=True)
+    rows = sorted(rows, key=lambda x: x[1])
+    result = ''.join(f'{a},{b}\n' for a, b in rows)
+    assert result == run(csv, "bsv | bschema '*,a:i64' | bsort 2:i64,-1:str | bschema '*,i64:a' | csv")
+
 def test_basic2():
     stdin = """
     a,b
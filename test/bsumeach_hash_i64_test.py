@@ -30,3 +30,14 @@ def test_basic():
     b,9
     """
     assert rm_whitespace(stdout) + '\n' == run(rm_whitespace(stdin), 'bsv | bschema *,a:i64 | bsumeach-hash i64 | bschema *,i64:a | bsort | csv')
+
+def test_spills():
+    keys = [f'k{i}' for i in range(100000)]
+    stdin = '\n'.join(f'{k},{i % 7}' for i, k in enumerate(keys + keys[::3])) + '\n'
+    sums = {}
+    for i, k in enumerate(keys + keys[::3]):
+        sums[k] = sums.get(k, 0) + i % 7
+    stdout = '\n'.join(f'{k},{sums[k]}' for k in sorted(sums)) + '\n'
+    assert stdout == run(stdin, 'bsv | bschema *,a:i64 | bsumeach-hash i64 | bschema *,i64:a | bsort | csv')
+    assert stdout == run(stdin, 'bsv | bschema *,a:i64 | bsumeach-hash i64 --memory-limit 2M | bschema *,i64:a | bsort | csv')
+    assert stdout == run(stdin, 'bsv | bschema *,a:i64 | bsumeach-hash i64 --jobs 4 | bschema *,i64:a | bsort | csv')
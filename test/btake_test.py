@@ -12,7 +12,7 @@ def setup_module(m):
     m.path = os.environ['PATH']
     os.chdir(m.tempdir)
     os.environ['PATH'] = f'{os.getcwd()}/bin:/usr/bin:/usr/local/bin:/sbin:/usr/sbin:/bin'
-    shell.run('make clean && make bsv csv btake', stream=True)
+    shell.run('make clean && make bsv csv btake bsort blz4 bdropuntil', stream=True)
 
 def teardown_module(m):
     os.chdir(m.orig)
@@ -57,3 +57,10 @@ def test_props(args):
     value, csv = args
     result = expected(value, csv)
     assert result == run(csv, f'bsv | btake "{value}" | csv')
+
+@given(inputs())
+@settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
+def test_props_stats(args):
+    value, csv = args
+    result = run(csv, f'bsv | bsort | bdropuntil "{value}" | btake "{value}" | csv')
+    assert result == run(csv, f'bsv | bsort --stats | blz4 | bdropuntil "{value}" | btake "{value}" | csv')
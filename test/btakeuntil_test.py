@@ -23,7 +23,9 @@ def setup_module(m):
     compile_buffer_sizes('bsv', buffers)
     compile_buffer_sizes('bsort', buffers)
     compile_buffer_sizes('btakeuntil', buffers)
-    shell.run('make bsv csv bsort btakeuntil', stream=True)
+    compile_buffer_sizes('bindex', buffers)
+    compile_buffer_sizes('blz4', buffers)
+    shell.run('make bsv csv bsort btakeuntil bindex blz4', stream=True)
 
 def teardown_module(m):
     os.chdir(m.orig)
@@ -67,6 +69,21 @@ def test_props(args):
     result = expected(value, csv)
     assert set(result.splitlines()) == set(run(csv, f'bsv.{buffer} | bsort.{buffer} | btakeuntil.{buffer} "{value}" | csv.{buffer}').splitlines()) # set because sort is not stable and is only for first column values
 
+@given(inputs())
+@settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
+def test_props_index(args):
+    value, csv, buffer = args
+    result = expected(value, csv)
+    assert set(result.splitlines()) == set(run(csv, f'bsv.{buffer} | bsort.{buffer} --index data.bsort.idx > data && bindex.{buffer} data && cmp data.bsort.idx data.idx && btakeuntil.{buffer} "{value}" --index data.idx < data | csv.{buffer}').splitlines())
+
+@given(inputs())
+@settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
+def test_props_stats(args):
+    value, csv, buffer = args
+    result = expected(value, csv)
+    assert set(result.splitlines()) == set(run(csv, f'bsv.{buffer} | bsort.{buffer} --stats > data && btakeuntil.{buffer} "{value}" < data | csv.{buffer}').splitlines())
+    assert set(result.splitlines()) == set(run(csv, f'bsv.{buffer} | bsort.{buffer} --stats | blz4.{buffer} | btakeuntil.{buffer} "{value}" | csv.{buffer}').splitlines())
+
 words = [
     "Abelson", "Aberdeen", "Allison", "Amsterdam", "Apollos", "Arabian",
     "Assad", "Austerlitz", "Bactria", "Baldwin", "Belinda", "Bethe", "Blondel",
@@ -55,3 +55,8 @@ def test_props(args):
     buffer, n, csv = args
     result = expected(n, csv)
     assert result == run(csv, f'bsv.{buffer} | btopn.{buffer} {n} | bcut.{buffer} 1 | csv.{buffer}')
+
+def test_composite():
+    stdin = 'a,1\nb,3\nc,2\nd,3\ne,1\n'
+    stdout = 'd,3\nb,3\nc,2\n'
+    assert stdout == run(stdin, 'bsv.128 | btopn.128 3 2:str,1:str | csv.128')
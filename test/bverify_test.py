@@ -0,0 +1,74 @@
+import os
+import string
+import shell
+import random
+from hypothesis.database import ExampleDatabase
+from hypothesis import given, settings
+from hypothesis.strategies import lists, composite, integers, text, sampled_from
+from test_util import clone_source, compile_buffer_sizes
+
+if os.environ.get('TEST_FACTOR'):
+    buffers = list(sorted(set([128, 256, 1024, 1024 * 1024 * 5] + [random.randint(128, 1024) for _ in range(10)])))
+else:
+    buffers = [128]
+
+def setup_module(m):
+    m.tempdir = clone_source()
+    m.orig = os.getcwd()
+    m.path = os.environ['PATH']
+    os.chdir(m.tempdir)
+    os.environ['PATH'] = f'{os.getcwd()}/bin:/usr/bin:/usr/local/bin:/sbin:/usr/sbin:/bin'
+    shell.run('make clean && make bsv csv bcat blz4 blz4d bpartition bverify bsort', stream=True)
+    compile_buffer_sizes('csv', buffers)
+    compile_buffer_sizes('bsv', buffers)
+    compile_buffer_sizes('bcat', buffers)
+    compile_buffer_sizes('blz4', buffers)
+    compile_buffer_sizes('blz4d', buffers)
+    compile_buffer_sizes('bpartition', buffers)
+    compile_buffer_sizes('bverify', buffers)
+    compile_buffer_sizes('bsort', buffers)
+
+def teardown_module(m):
+    os.chdir(m.orig)
+    os.environ['PATH'] = m.path
+    assert m.tempdir.startswith('/tmp/') or m.tempdir.startswith('/private/var/folders/')
+    shell.run('rm -rf', m.tempdir)
+
+@composite
+def inputs(draw):
+    buffer = draw(sampled_from(buffers))
+    num_columns = draw(integers(min_value=1, max_value=12))
+    column = text(string.ascii_lowercase, min_size=1)
+    columns = lists(column, min_size=num_columns, max_size=num_columns)
+    lines = draw(lists(columns, min_size=1))
+    csv = '\n'.join([','.join(line)[:64] for line in lines])
+    return buffer, csv
+
+@given(inputs())
+@settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
+def test_props(args):
+    buffer, csv = args
+    with shell.tempdir():
+        shell.run(f'bsv.{buffer} | blz4.{buffer} --checksum > compressed', stdin=csv)
+        shell.run(f'bsv.{buffer} | bpartition.{buffer} --checksum 1 plain', stdin=csv)
+        shell.run(f'bverify.{buffer} -j 3 compressed plain_0')
+        assert csv == shell.run(f'blz4d.{buffer} < compressed | csv.{buffer}')
+        assert csv == shell.run(f'bcat.{buffer} compressed')
+        assert csv == shell.run(f'bcat.{buffer} plain_0')
+        size = int(shell.run('stat -c %s plain_0'))
+        shell.run(f'printf "\\xff" | dd of=plain_0 bs=1 seek={size - 9} conv=notrunc')
+        assert shell.run(f'bverify.{buffer} plain_0', warn=True)['exitcode'] != 0
+        assert shell.run(f'bcat.{buffer} plain_0', warn=True)['exitcode'] != 0
+        shell.run(f'bcat.{buffer} --no-verify plain_0')
+
+@given(inputs())
+@settings(database=ExampleDatabase(':memory:'), max_examples=100 * int(os.environ.get('TEST_FACTOR', 1)), deadline=os.environ.get("TEST_DEADLINE", 1000 * 60)) # type: ignore
+def test_props_stats(args):
+    buffer, csv = args
+    with shell.tempdir():
+        shell.run(f'bsv.{buffer} | bsort.{buffer} --stats > sorted', stdin=csv)
+        shell.run(f'blz4.{buffer} --checksum < sorted > compressed')
+        shell.run(f'bverify.{buffer} sorted compressed')
+        assert shell.run(f'csv.{buffer} < sorted') == shell.run(f'blz4d.{buffer} < compressed | csv.{buffer}')
+        shell.run('printf "\\xff" | dd of=sorted bs=1 seek=14 conv=notrunc')
+        assert shell.run(f'bverify.{buffer} sorted', warn=True)['exitcode'] != 0
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "util.h"
+
+//
+// a bump allocator for many small allocations that all die together,
+// like the per row metadata of a sort. allocations are carved out of
+// large blocks and are never freed one by one. arena_reset() releases
+// them all at once but keeps the blocks for reuse, and arena_free()
+// gives the blocks back.
+//
+
+#define ARENA_BLOCK_SIZE 1024 * 1024
+#define ARENA_ALIGN 8
+
+typedef struct arena_s {
+    u8 **blocks;
+    i32 num_blocks;
+    i32 capacity;
+    i32 block; // -------------------------------- index of the block being carved
+    u64 offset; // ------------------------------- bytes used of that block
+} arena_t;
+
+arena_t arena_init() {
+    arena_t arena;
+    arena.capacity = 16;
+    arena.num_blocks = 0;
+    arena.block = -1;
+    arena.offset = ARENA_BLOCK_SIZE;
+    MALLOC(arena.blocks, sizeof(u8*) * arena.capacity);
+    return arena;
+}
+
+// move to the next block, allocating it if this is the first time through
+inlined void arena_next(arena_t *arena) {
+    arena->block++;
+    arena->offset = 0;
+    if (arena->block < arena->num_blocks)
+        return;
+    if (arena->num_blocks == arena->capacity) {
+        arena->capacity *= 2;
+        REALLOC(arena->blocks, sizeof(u8*) * arena->capacity);
+    }
+    MALLOC(arena->blocks[arena->num_blocks], ARENA_BLOCK_SIZE);
+    arena->num_blocks++;
+}
+
+inlined void *arena_alloc(arena_t *arena, u64 size) {
+    size = (size + ARENA_ALIGN - 1) & ~(u64)(ARENA_ALIGN - 1);
+    ASSERT(size <= ARENA_BLOCK_SIZE, "fatal: arena allocation bigger than a block: %lu\n", size);
+    if (arena->offset + size > ARENA_BLOCK_SIZE)
+        arena_next(arena);
+    void *ptr = arena->blocks[arena->block] + arena->offset;
+    arena->offset += size;
+    return ptr;
+}
+
+// release every allocation at once, keeping the blocks to carve again
+inlined void arena_reset(arena_t *arena) {
+    arena->block = -1;
+    arena->offset = ARENA_BLOCK_SIZE;
+}
+
+void arena_free(arena_t *arena) {
+    for (i32 i = 0; i < arena->num_blocks; i++)
+        free(arena->blocks[i]);
+    free(arena->blocks);
+    arena->num_blocks = 0;
+    arena->blocks = NULL;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "util.h"
+#include "lz4.h"
+#include "xxh3.h"
+#ifdef LZ4HC
+#include <lz4hc.h>
+#endif
+#ifdef ZSTD
+#include <zstd.h>
+#endif
+
+//
+// a codec is a type in the low byte and a level above it, parsed from
+// strings like "lz4", "lz4hc:9" or "zstd:19". a level of 0 means the
+// default for that type. for lz4 the level is the acceleration passed to
+// LZ4_compress_fast(), so unlike lz4hc and zstd a higher number is
+// faster and compresses less. use lz4hc for a better ratio.
+//
+// compressed chunks carry their codec type in the high byte of their
+// size, which is always less than 1<<24, so readers can tell how to
+// decompress a chunk without being told. chunks without a tag are
+// either plain or, when a reader is given -l, legacy lz4.
+//
+// the bit above the codec marks a chunk followed by a u64 xxh3 of its
+// body, seeded with its header, so torn or corrupted chunks are caught
+// instead of turning into bad sizes or wrong rows.
+//
+// the bit above that marks a chunk whose header is followed by its
+// stats, see stats.h.
+//
+enum codec_type {
+    CODEC_NONE,
+    CODEC_LZ4,
+    CODEC_LZ4HC,
+    CODEC_ZSTD,
+    CODEC_TYPES,
+};
+
+#define CODEC(type, level) ((type) | (level) << 8)
+#define CODEC_TYPE(codec) ((codec) & 0xff)
+#define CODEC_LEVEL(codec) ((codec) >> 8)
+
+#define CHUNK_SIZE_BITS 24
+#define CHUNK_SIZE(header) ((header) & ((1 << CHUNK_SIZE_BITS) - 1))
+#define CHUNK_CODEC(header) (((u32)(header) >> CHUNK_SIZE_BITS) & 0x0f)
+#define CHUNK_HEADER(size, codec) ((size) | CODEC_TYPE(codec) << CHUNK_SIZE_BITS)
+#define CHUNK_CHECKSUM (1 << 28)
+#define CHUNK_STATS (1 << 29)
+#define CHUNK_VALID(header) (CHUNK_SIZE(header) <= BUFFER_SIZE && CHUNK_CODEC(header) < CODEC_TYPES && !((u32)(header) >> 30))
+
+#define LZ4HC_DEFAULT_LEVEL 9
+#define ZSTD_DEFAULT_LEVEL 3
+
+char *codec_names[CODEC_TYPES] = {"none", "lz4", "lz4hc", "zstd"};
+
+void codec_supported(i32 type) {
+    #ifndef LZ4HC
+    ASSERT(type != CODEC_LZ4HC, "fatal: lz4hc support not compiled in, rebuild with: make LZ4HC=1\n");
+    #endif
+    #ifndef ZSTD
+    ASSERT(type != CODEC_ZSTD, "fatal: zstd support not compiled in, rebuild with: make ZSTD=1\n");
+    #endif
+}
+
+i32 codec_parse(char *spec) {
+    char *colon = strchr(spec, ':');
+    i32 len = colon ? colon - spec : strlen(spec);
+    i32 level = 0;
+    if (colon) {
+        ASSERT(isdigits(colon + 1) && strlen(colon + 1) > 0 && strlen(colon + 1) < 4, "fatal: bad codec level: %s\n", spec);
+        level = atoi(colon + 1);
+    }
+    for (i32 type = 0; type < CODEC_TYPES; type++) {
+        if (strlen(codec_names[type]) == len && strncmp(spec, codec_names[type], len) == 0) {
+            codec_supported(type);
+            return CODEC(type, level);
+        }
+    }
+    ASSERT(0, "fatal: unknown codec: %s, expected one of: none, lz4, lz4hc, zstd\n", spec);
+}
+
+// compress size bytes of src into dst, which must hold at least BUFFER_SIZE_LZ4 bytes, and return the compressed size
+inlined i32 codec_compress(i32 codec, u8 *src, u8 *dst, i32 size) {
+    i32 level = CODEC_LEVEL(codec);
+    switch (CODEC_TYPE(codec)) {
+        case CODEC_LZ4:
+            return LZ4_compress_fast(src, dst, size, BUFFER_SIZE_LZ4, level ? level : LZ4_ACCELERATION);
+        #ifdef LZ4HC
+        case CODEC_LZ4HC:
+            return LZ4_compress_HC(src, dst, size, BUFFER_SIZE_LZ4, level ? level : LZ4HC_DEFAULT_LEVEL);
+        #endif
+        #ifdef ZSTD
+        case CODEC_ZSTD: {
+            static __thread ZSTD_CCtx *ctx = NULL; // ------------------------------- reuse a context per thread, creating one costs more than compressing a small chunk
+            if (!ctx)
+                ASSERT(ctx = ZSTD_createCCtx(), "fatal: ZSTD_createCCtx\n");
+            size_t n = ZSTD_compressCCtx(ctx, dst, BUFFER_SIZE_LZ4, src, size, level ? level : ZSTD_DEFAULT_LEVEL);
+            ASSERT(!ZSTD_isError(n), "fatal: zstd compress: %s\n", ZSTD_getErrorName(n));
+            return n;
+        }
+        #endif
+        default:
+            ASSERT(0, "fatal: cannot compress with codec: %d\n", CODEC_TYPE(codec));
+    }
+}
+
+// decompress src_size bytes of src into dst, which only needs room for the size bytes they must decompress to
+inlined bool codec_try_decompress(i32 type, u8 *src, i32 src_size, u8 *dst, i32 size) {
+    switch (type) {
+        case CODEC_LZ4:
+        case CODEC_LZ4HC: // --------------------------------------------------------- lz4hc output is plain lz4 to the decoder
+            return size == LZ4_decompress_safe(src, dst, src_size, size);
+        #ifdef ZSTD
+        case CODEC_ZSTD: {
+            static __thread ZSTD_DCtx *ctx = NULL;
+            if (!ctx)
+                ASSERT(ctx = ZSTD_createDCtx(), "fatal: ZSTD_createDCtx\n");
+            return size == ZSTD_decompressDCtx(ctx, dst, size, src, src_size);
+        }
+        #endif
+        default:
+            codec_supported(type);
+            ASSERT(0, "fatal: bad chunk codec: %d\n", type);
+    }
+}
+
+inlined void codec_decompress(i32 type, u8 *src, i32 src_size, u8 *dst, i32 size) {
+    ASSERT(codec_try_decompress(type, src, src_size, dst, size), "fatal: decompress size mismatch\n");
+}
+
+// the body of a compressed chunk is its compressed bytes. stats, if any, are covered by folding their hash into the seed.
+inlined u64 chunk_checksum(i32 header, u64 stats_hash, u8 *body, i32 size) {
+    return XXH3_64bits_withSeed(body, size, (u32)header ^ stats_hash);
+}
@@ -27,6 +27,22 @@ inlined void dump(writebuf_t *wbuf, const row_t *row, i32 file) {
     }
 }
 
+// write the columns of left followed by every column of right but the first, which is the key they were joined on
+inlined void dump_join(writebuf_t *wbuf, const row_t *left, const row_t *right, i32 file) {
+    row_t row;
+    row.max = left->max + right->max;
+    ASSERT(row.max < MAX_COLUMNS, "fatal: joined row has too many columns: %d\n", row.max + 1);
+    for (i32 i = 0; i <= left->max; i++) {
+        row.columns[i] = left->columns[i];
+        row.sizes[i] = left->sizes[i];
+    }
+    for (i32 i = 1; i <= right->max; i++) {
+        row.columns[left->max + i] = right->columns[i];
+        row.sizes[left->max + i] = right->sizes[i];
+    }
+    dump(wbuf, &row, file);
+}
+
 inlined void dump_raw(writebuf_t *wbuf, const raw_row_t *raw_row, i32 file) {
     write_start(wbuf, raw_row->header_size + raw_row->buffer_size, file);
     write_bytes(wbuf, raw_row->header, raw_row->header_size, file);
@@ -35,4 +51,7 @@ inlined void dump_raw(writebuf_t *wbuf, const raw_row_t *raw_row, i32 file) {
 
 void dump_flush(writebuf_t *wbuf, i32 file) {
     write_flush(wbuf, file);
+    write_wait(wbuf, file);
+    if (wbuf->index)
+        index_flush(wbuf->index);
 }
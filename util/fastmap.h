@@ -25,8 +25,8 @@
     u64   map##_size = initial_size;                        \
     u8  **map##_keys;                                       \
     u8  *map##_keys_buf;                                    \
-    u8  **map##_keys_bufs_last;                             \
-    u64  map##_keys_bufs_last_size;                         \
+    u8  **map##_keys_bufs_last = NULL;                      \
+    u64  map##_keys_bufs_last_size = 0;                     \
     u64  map##_keys_buf_remaining = FASTMAP_KEY_BUF_SIZE;   \
     MALLOC(map##_keys_buf, FASTMAP_KEY_BUF_SIZE);           \
     MALLOC(map##_keys, sizeof(u8*) * map##_size);           \
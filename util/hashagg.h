@@ -0,0 +1,317 @@
+#pragma once
+
+#include "util.h"
+#include "read.h"
+#include "write.h"
+#include "load.h"
+#include "dump.h"
+#include "swissmap.h"
+#include "ordered.h"
+
+//
+// hash aggregation of a sum per key, for bsumeach-hash, and for
+// bcounteach-hash, which sums an i64 1 per row.
+//
+// with a memory limit, whenever the map would outgrow it, every partial
+// sum is written to one of HASHAGG_FANOUT spill files by the top bits
+// of the hash of its key, and the map starts again empty. at the end
+// the map is spilled too, and each spill file is aggregated on its own
+// by the next bits of the hash, spilling again if it still does not
+// fit. a key only ever lands in one spill file at each level, so its
+// partial sums always meet again. spills are lz4 bsv rows of key and
+// sum in unlinked temp files in the tmpdir, written as small chunks
+// from a HASHAGG_SPILL_SIZE buffer per file.
+//
+// the limit covers the map and its keys. on top of it are the spill
+// buffers, and a chunk of input while a spill file is being read back.
+//
+
+#define HASHAGG_FANOUT_BITS 4
+#define HASHAGG_FANOUT (1 << HASHAGG_FANOUT_BITS)
+#define HASHAGG_MAX_DEPTH (64 / HASHAGG_FANOUT_BITS)
+#define HASHAGG_MIN_MEMORY (2 * ARENA_BLOCK_SIZE)
+#define HASHAGG_INITIAL_SIZE (1 << 16)
+#define HASHAGG_INITIAL_SIZE_LIMITED (1 << 10)
+#define HASHAGG_SPILL_SIZE MIN(BUFFER_SIZE, 1 << 17) // spill chunks are read back like any input, so never past BUFFER_SIZE
+
+typedef struct hashagg_s {
+    i32 value_type;
+    i32 value_size;
+    i64 memory_limit; // ------------------------- 0 for none
+    char *tmpdir;
+    i32 depth; // -------------------------------- how many levels of spill files the keys have been split by
+    swissmap_t map;
+    FILE *spills[HASHAGG_FANOUT];
+    u8 *spill_buffers[HASHAGG_FANOUT];
+    i32 spill_sizes[HASHAGG_FANOUT];
+    u8 *codec_buf;
+    bool spilled;
+} hashagg_t;
+
+inlined i32 hashagg_value_size(i32 value_type) {
+    switch (value_type) {
+        case I64: return sizeof(i64);
+        case I32: return sizeof(i32);
+        case I16: return sizeof(i16);
+        case U64: return sizeof(u64);
+        case U32: return sizeof(u32);
+        case U16: return sizeof(u16);
+        case F64: return sizeof(f64);
+        case F32: return sizeof(f32);
+        default: ASSERT(0, "fatal: cannot sum type: %d\n", value_type);
+    }
+}
+
+inlined void hashagg_sum(i32 value_type, void *sum, const void *value) {
+    switch (value_type) {
+        case I64: *(i64*)sum += *(i64*)value; break;
+        case I32: *(i32*)sum += *(i32*)value; break;
+        case I16: *(i16*)sum += *(i16*)value; break;
+        case U64: *(u64*)sum += *(u64*)value; break;
+        case U32: *(u32*)sum += *(u32*)value; break;
+        case U16: *(u16*)sum += *(u16*)value; break;
+        case F64: *(f64*)sum += *(f64*)value; break;
+        case F32: *(f32*)sum += *(f32*)value; break;
+    }
+}
+
+hashagg_t hashagg_init(i32 value_type, i64 memory_limit, char *tmpdir, i32 depth) {
+    hashagg_t agg;
+    ASSERT(!memory_limit || memory_limit >= HASHAGG_MIN_MEMORY, "fatal: --memory-limit must be at least %d bytes\n", HASHAGG_MIN_MEMORY);
+    ASSERT(depth < HASHAGG_MAX_DEPTH, "fatal: too many distinct keys sharing a hash prefix to fit in --memory-limit\n");
+    agg.value_type = value_type;
+    agg.value_size = hashagg_value_size(value_type);
+    agg.memory_limit = memory_limit;
+    agg.tmpdir = tmpdir;
+    agg.depth = depth;
+    agg.map = swissmap_init(memory_limit ? HASHAGG_INITIAL_SIZE_LIMITED : HASHAGG_INITIAL_SIZE, agg.value_size); // sums start at zero, so a new key is added to like any other
+    agg.spilled = false;
+    return agg;
+}
+
+inlined void hashagg_spill_flush(hashagg_t *agg, i32 spill) {
+    if (agg->spill_sizes[spill]) {
+        write_chunk(agg->spills[spill], agg->spill_buffers[spill], agg->spill_sizes[spill], CODEC_LZ4, agg->codec_buf, false, NO_STATS);
+        agg->spill_sizes[spill] = 0;
+    }
+}
+
+// append a row of key and sum to a spill file, laid out as dump() would
+inlined void hashagg_spill_row(hashagg_t *agg, i32 spill, const u8 *key, i32 size, const void *value) {
+    i32 row_size = sizeof(u16) * 3 + size + 1 + agg->value_size + 1;
+    u8 *dst;
+    ASSERT(row_size <= HASHAGG_SPILL_SIZE, "fatal: row too large to spill: %d\n", row_size);
+    if (row_size > HASHAGG_SPILL_SIZE - agg->spill_sizes[spill])
+        hashagg_spill_flush(agg, spill);
+    dst = agg->spill_buffers[spill] + agg->spill_sizes[spill];
+    *(u16*)dst = 1;
+    *(u16*)(dst + sizeof(u16)) = size;
+    *(u16*)(dst + sizeof(u16) * 2) = agg->value_size;
+    dst += sizeof(u16) * 3;
+    memcpy(dst, key, size);
+    dst[size] = '\0';
+    dst += size + 1;
+    memcpy(dst, value, agg->value_size);
+    dst[agg->value_size] = '\0';
+    agg->spill_sizes[spill] += row_size;
+}
+
+// write every partial sum to the spill file of its key, and empty the map
+void hashagg_spill(hashagg_t *agg) {
+    i32 shift = 64 - HASHAGG_FANOUT_BITS * (agg->depth + 1);
+    if (!agg->spilled) {
+        for (i32 i = 0; i < HASHAGG_FANOUT; i++) {
+            agg->spills[i] = temp_open(agg->tmpdir, "hashagg");
+            MALLOC(agg->spill_buffers[i], HASHAGG_SPILL_SIZE);
+            agg->spill_sizes[i] = 0;
+        }
+        codec_supported(CODEC_LZ4);
+        MALLOC(agg->codec_buf, BUFFER_SIZE_LZ4);
+        agg->spilled = true;
+    }
+    for (u64 i = 0; i < SWISSMAP_CAPACITY(agg->map); i++)
+        if (swissmap_full(&agg->map, i))
+            hashagg_spill_row(agg, (agg->map.slots[i].hash >> shift) & (HASHAGG_FANOUT - 1), agg->map.slots[i].key, agg->map.slots[i].size, swissmap_value(&agg->map, i));
+    swissmap_free(&agg->map);
+    agg->map = swissmap_init(HASHAGG_INITIAL_SIZE_LIMITED, agg->value_size);
+}
+
+// add value to the sum of key
+inlined void hashagg_add(hashagg_t *agg, const u8 *key, i32 size, const void *value) {
+    bool added;
+    u64 memory;
+    hashagg_sum(agg->value_type, swissmap_value(&agg->map, swissmap_upsert(&agg->map, key, size, &added)), value);
+    if (added && agg->memory_limit) {
+        memory = swissmap_memory(&agg->map);
+        if (swissmap_growing(&agg->map)) // ----------------------------------------------------------------- the next key would need the old table and a new one twice its size
+            memory += SWISSMAP_CAPACITY(agg->map) * 2 * (1 + sizeof(swissmap_slot_t) + agg->value_size);
+        if (memory > agg->memory_limit)
+            hashagg_spill(agg);
+    }
+}
+
+// write every key of map and its sum to wbuf
+void hashagg_dump(swissmap_t *map, writebuf_t *wbuf) {
+    row_t row;
+    row.max = 1;
+    row.sizes[1] = map->value_size;
+    for (u64 i = 0; i < SWISSMAP_CAPACITY(*map); i++) {
+        if (swissmap_full(map, i)) {
+            row.columns[0] = map->slots[i].key;
+            row.sizes[0] = map->slots[i].size;
+            row.columns[1] = swissmap_value(map, i);
+            dump(wbuf, &row, 0);
+        }
+    }
+}
+
+// write every key and its sum to wbuf, aggregating the spill files one by one if there are any
+void hashagg_finish(hashagg_t *agg, writebuf_t *wbuf) {
+    row_t row;
+    hashagg_t child;
+    readbuf_t rbuf;
+    if (!agg->spilled) {
+        hashagg_dump(&agg->map, wbuf);
+        swissmap_free(&agg->map);
+        return;
+    }
+    hashagg_spill(agg);
+    swissmap_free(&agg->map);
+    for (i32 i = 0; i < HASHAGG_FANOUT; i++) {
+        hashagg_spill_flush(agg, i);
+        free(agg->spill_buffers[i]);
+        ASSERT(0 == fflush(agg->spills[i]), "fatal: failed to flush temp file\n");
+        ASSERT(0 == fseeko(agg->spills[i], 0, SEEK_SET), "fatal: failed to rewind temp file\n");
+    }
+    free(agg->codec_buf);
+    for (i32 i = 0; i < HASHAGG_FANOUT; i++) {
+        child = hashagg_init(agg->value_type, agg->memory_limit, agg->tmpdir, agg->depth + 1);
+        rbuf = rbuf_init(&agg->spills[i], 1, true);
+        while (1) {
+            load_next(&rbuf, &row, 0);
+            if (row.stop)
+                break;
+            hashagg_add(&child, row.columns[0], row.sizes[0], row.columns[1]);
+        }
+        rbuf_free(&rbuf);
+        ASSERT(fclose(agg->spills[i]) != EOF, "fatal: failed to close temp file\n");
+        hashagg_finish(&child, wbuf);
+    }
+}
+
+//
+// with jobs, whole input chunks are handed to worker threads, and each
+// sums into HASHAGG_PARTS maps of its own, picked by the top bits of
+// the hash of the key. once the input is done, every part is merged
+// across the workers by a single thread, which owns that part of every
+// worker alone, so merging takes no locks and the stored hashes are
+// reused. merged parts are written to stdout in whole chunks under a
+// lock, in whatever order they finish.
+//
+
+#define HASHAGG_PARTS_BITS 6
+#define HASHAGG_PARTS (1 << HASHAGG_PARTS_BITS)
+
+typedef const void *(*hashagg_value_fn_t)(row_t *row); // -------------------------- the value a row adds to the sum of its first column
+
+i32 hashagg_jobs_type;
+hashagg_value_fn_t hashagg_jobs_value;
+swissmap_t **hashagg_workers;
+i32 hashagg_num_workers = 0;
+i32 hashagg_next_part = 0;
+pthread_mutex_t hashagg_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t hashagg_stdout_lock = PTHREAD_MUTEX_INITIALIZER;
+FILE *hashagg_stdout[1];
+
+// the parts of the calling worker, set up the first time it is called
+swissmap_t *hashagg_worker_parts() {
+    static __thread swissmap_t *parts = NULL;
+    if (!parts) {
+        MALLOC(parts, sizeof(swissmap_t) * HASHAGG_PARTS);
+        for (i32 i = 0; i < HASHAGG_PARTS; i++)
+            parts[i] = swissmap_init(HASHAGG_INITIAL_SIZE_LIMITED, hashagg_value_size(hashagg_jobs_type));
+        MUTEX_LOCK(hashagg_lock);
+        hashagg_workers[hashagg_num_workers++] = parts;
+        MUTEX_UNLOCK(hashagg_lock);
+    }
+    return parts;
+}
+
+void hashagg_chunk(ordered_chunk_t *chunk) {
+    swissmap_t *parts = hashagg_worker_parts();
+    swissmap_t *part;
+    row_t row;
+    bool added;
+    u64 hash;
+    i32 size;
+    for (i32 offset = 0; offset < chunk->size; offset += size) {
+        size = row_from_raw(chunk->in + offset, &row);
+        hash = XXH3_64bits(row.columns[0], row.sizes[0]);
+        part = &parts[hash >> (64 - HASHAGG_PARTS_BITS)];
+        hashagg_sum(hashagg_jobs_type, swissmap_value(part, swissmap_upsert_hash(part, row.columns[0], row.sizes[0], hash, &added)), hashagg_jobs_value(&row));
+    }
+}
+
+void hashagg_chunk_done(ordered_chunk_t *chunk) {
+    (void)chunk;
+}
+
+void *hashagg_merge(void *arg) {
+    swissmap_t *dst;
+    swissmap_t *src;
+    bool added;
+    i32 part;
+    writebuf_t wbuf = wbuf_init(hashagg_stdout, 1, false);
+    wbuf_shared(&wbuf, &hashagg_stdout_lock);
+    while (1) {
+        MUTEX_LOCK(hashagg_lock);
+        part = hashagg_next_part++;
+        MUTEX_UNLOCK(hashagg_lock);
+        if (part >= HASHAGG_PARTS)
+            break;
+        dst = &hashagg_workers[0][part];
+        for (i32 w = 1; w < hashagg_num_workers; w++) {
+            src = &hashagg_workers[w][part];
+            for (u64 i = 0; i < SWISSMAP_CAPACITY(*src); i++)
+                if (swissmap_full(src, i))
+                    hashagg_sum(hashagg_jobs_type, swissmap_value(dst, swissmap_upsert_hash(dst, src->slots[i].key, src->slots[i].size, src->slots[i].hash, &added)), swissmap_value(src, i));
+            swissmap_free(src);
+        }
+        hashagg_dump(dst, &wbuf);
+        swissmap_free(dst);
+    }
+    (void)arg;
+    dump_flush(&wbuf, 0);
+    return NULL;
+}
+
+// sum value(row) by the first column of every row of rbuf on jobs threads, and write the sums to stdout
+void hashagg_parallel(i32 value_type, hashagg_value_fn_t value, i32 jobs, readbuf_t *rbuf) {
+    ordered_t *o;
+    ordered_chunk_t *chunk;
+    pthread_t *threads;
+    u8 *buffer;
+    hashagg_jobs_type = value_type;
+    hashagg_jobs_value = value;
+    hashagg_stdout[0] = stdout;
+    MALLOC(hashagg_workers, sizeof(swissmap_t*) * jobs);
+    o = ordered_init(jobs, BUFFER_SIZE, 1, hashagg_chunk, hashagg_chunk_done);
+    while (1) {
+        chunk = ordered_next(o);
+        buffer = chunk->in;
+        chunk->size = read_chunk(rbuf, &buffer, rbuf->codec_buf, 0);
+        if (chunk->size == -1)
+            break;
+        if (buffer != chunk->in) // ----------------------------------------------------------------- zero copy reads point into the mapping instead
+            memcpy(chunk->in, buffer, chunk->size);
+        ordered_submit(o);
+    }
+    ordered_finish(o);
+    if (!hashagg_num_workers) // ------------------------------------------------------------------------ no input
+        return;
+    MALLOC(threads, sizeof(pthread_t) * jobs);
+    for (i32 i = 0; i < jobs; i++)
+        THREAD_CREATE(threads[i], hashagg_merge, NULL);
+    for (i32 i = 0; i < jobs; i++)
+        THREAD_JOIN(threads[i]);
+}
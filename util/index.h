@@ -0,0 +1,133 @@
+#pragma once
+
+#include "load.h"
+#include <sys/stat.h>
+
+//
+// an index sidecar, as written by wbuf_index() or bindex, loaded for
+// binary search. keys are copied out of the index file and keep their
+// trailing \0, so they compare like any other column.
+//
+
+typedef struct index_s {
+    i64 data_size;
+    i32 size;
+    i64 *offsets;
+    u8 **first;
+    i32 *first_sizes;
+    u8 **last;
+    i32 *last_sizes;
+} index_t;
+
+inlined u8 *index_key(row_t *row, i32 column) {
+    u8 *key;
+    MALLOC(key, row->sizes[column] + 1);
+    memcpy(key, row->columns[column], row->sizes[column] + 1);
+    return key;
+}
+
+// the offset just past the chunk at offset in fd, as it is on disk
+inlined i64 index_chunk_end(i32 fd, i64 offset) {
+    u8 stats[STATS_HEADER_SIZE];
+    i32 header;
+    i32 size;
+    ASSERT(sizeof(i32) == pread(fd, &header, sizeof(i32), offset), "fatal: failed to read input\n");
+    ASSERT(CHUNK_VALID(header), "fatal: bad chunk header at offset: %ld\n", offset);
+    size = CHUNK_SIZE(header);
+    offset += sizeof(i32);
+    if (header & CHUNK_STATS) {
+        ASSERT(STATS_HEADER_SIZE == pread(fd, stats, STATS_HEADER_SIZE, offset), "fatal: failed to read input\n");
+        offset += stats_length(stats);
+    }
+    if (CHUNK_CODEC(header) != CODEC_NONE) {
+        ASSERT(sizeof(i32) == pread(fd, &size, sizeof(i32), offset), "fatal: failed to read input\n");
+        offset += sizeof(i32);
+    }
+    offset += size;
+    if (header & CHUNK_CHECKSUM)
+        offset += sizeof(u64);
+    return offset;
+}
+
+// load the index of data, which must be a regular file the index is not older than
+index_t index_load(char *path, FILE *data) {
+    struct stat data_st;
+    struct stat index_st;
+    ASSERT(0 == fstat(fileno(data), &data_st), "fatal: failed to stat input\n");
+    ASSERT(0 == stat(path, &index_st), "fatal: failed to stat index: %s\n", path);
+    ASSERT(index_st.st_mtime >= data_st.st_mtime, "fatal: index is older than its input: %s\n", path);
+    FILE *file;
+    FOPEN(file, path, "rb");
+    readbuf_t rbuf = rbuf_init((FILE*[]){file}, 1, false);
+    row_t row;
+    index_t index;
+    i32 capacity = 1024;
+    index.size = 0;
+    index.data_size = data_st.st_size;
+    MALLOC(index.offsets, sizeof(i64) * capacity);
+    MALLOC(index.first, sizeof(u8*) * capacity);
+    MALLOC(index.first_sizes, sizeof(i32) * capacity);
+    MALLOC(index.last, sizeof(u8*) * capacity);
+    MALLOC(index.last_sizes, sizeof(i32) * capacity);
+    while (1) {
+        load_next(&rbuf, &row, 0);
+        if (row.stop)
+            break;
+        ASSERT(row.max == 2 && row.sizes[0] == sizeof(i64), "fatal: bad index row in: %s\n", path);
+        if (index.size == capacity) {
+            capacity *= 2;
+            REALLOC(index.offsets, sizeof(i64) * capacity);
+            REALLOC(index.first, sizeof(u8*) * capacity);
+            REALLOC(index.first_sizes, sizeof(i32) * capacity);
+            REALLOC(index.last, sizeof(u8*) * capacity);
+            REALLOC(index.last_sizes, sizeof(i32) * capacity);
+        }
+        index.offsets[index.size] = *(i64*)row.columns[0];
+        ASSERT(index.offsets[index.size] < data_st.st_size, "fatal: index does not match its input: %s\n", path);
+        index.first[index.size] = index_key(&row, 1);
+        index.first_sizes[index.size] = row.sizes[1];
+        index.last[index.size] = index_key(&row, 2);
+        index.last_sizes[index.size] = row.sizes[2];
+        index.size++;
+    }
+    if (index.size) // ---------------------------------------------------------------------------------- offsets that are all in bounds can still be shifted, so the last chunk must end the input
+        ASSERT(index_chunk_end(fileno(data), index.offsets[index.size - 1]) == data_st.st_size, "fatal: index does not match its input: %s\n", path);
+    ASSERT(fclose(file) != EOF, "fatal: failed to close files\n");
+    return index;
+}
+
+// for sorted data, return the first chunk whose last key is gte val, or index->size if there is none
+i32 index_search(index_t *index, i32 value_type, void *val) {
+    i32 lo = 0;
+    i32 hi = index->size;
+    i32 mid;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        ASSERT_SIZE(value_type, index->last_sizes[mid]);
+        if (compare(value_type, index->last[mid], val) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// true when file is a regular file, so it can be seeked and read at an offset
+bool index_seekable(FILE *file) {
+    struct stat st;
+    return fstat(fileno(file), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+// copy the bytes of in from offset start up to offset end to out, as they are on disk
+void index_copy_range(FILE *in, FILE *out, i64 start, i64 end) {
+    u8 *buffer;
+    i64 size;
+    MALLOC(buffer, BUFFER_SIZE);
+    while (start < end) {
+        size = pread(fileno(in), buffer, MIN(BUFFER_SIZE, end - start), start);
+        ASSERT(size > 0, "fatal: failed to read input\n");
+        FWRITE(buffer, size, out);
+        start += size;
+    }
+    free(buffer);
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "util.h"
+#include "row.h"
+#include "radix.h"
+
+//
+// a sort key of one or more columns, each compared as its own type,
+// parsed from specs like 1:i64,3:str,-2:f64 where columns count from
+// 1 and a negative column sorts in reverse. the compare function of
+// every field is looked up once when parsing, so comparing two rows
+// is a walk down a chain of function pointers with no switch on types.
+//
+// rows are compared by their raw headers, as laid out by dump_raw():
+//
+// | u16:max | u16:size | ... | u8[]:column | ... |
+//
+
+#define MAX_KEYS 16
+
+typedef struct keys_s {
+    i32 size;
+    i32 columns[MAX_KEYS]; // ------------------------ zero based
+    i32 types[MAX_KEYS];
+    compare_fn_t compares[MAX_KEYS];
+} keys_t;
+
+inlined i32 keys_type(char *name) {
+    if      (strcmp(name, "str") == 0) return STR;
+    else if (strcmp(name, "i64") == 0) return I64;
+    else if (strcmp(name, "i32") == 0) return I32;
+    else if (strcmp(name, "i16") == 0) return I16;
+    else if (strcmp(name, "u64") == 0) return U64;
+    else if (strcmp(name, "u32") == 0) return U32;
+    else if (strcmp(name, "u16") == 0) return U16;
+    else if (strcmp(name, "f64") == 0) return F64;
+    else if (strcmp(name, "f32") == 0) return F32;
+    else ASSERT(0, "fatal: bad type %s\n", name);
+}
+
+// a key of only the first column
+keys_t keys_single(i32 value_type) {
+    keys_t keys;
+    keys.size = 1;
+    keys.columns[0] = 0;
+    keys.types[0] = value_type;
+    keys.compares[0] = compare_fn(value_type);
+    return keys;
+}
+
+// true when arg is a key spec rather than a single type
+inlined bool keys_spec(char *arg) {
+    return strchr(arg, ':') != NULL;
+}
+
+// parse a spec like 1:i64,3:str,-2:f64, reversing every field when reversed
+keys_t keys_parse(char *spec, bool reversed) {
+    keys_t keys;
+    char *copy = strdup(spec);
+    char *field;
+    char *type;
+    char *rest = copy;
+    i32 column;
+    keys.size = 0;
+    while ((field = strsep(&rest, ","))) {
+        type = strchr(field, ':');
+        ASSERT(type, "fatal: should have been COLUMN:TYPE, not: %s\n", field);
+        *type++ = '\0';
+        ASSERT(isdigits(field + (field[0] == '-')) && strlen(field + (field[0] == '-')), "fatal: bad key column: %s\n", field);
+        column = atol(field);
+        ASSERT(column != 0 && abs(column) <= MAX_COLUMNS, "fatal: key columns count from 1, got: %d\n", column);
+        ASSERT(keys.size < MAX_KEYS, "fatal: too many key columns, max is %d\n", MAX_KEYS);
+        keys.columns[keys.size] = abs(column) - 1;
+        keys.types[keys.size] = keys_type(type);
+        if ((column < 0) != reversed)
+            keys.types[keys.size] += R_STR;
+        keys.compares[keys.size] = compare_fn(keys.types[keys.size]);
+        keys.size++;
+    }
+    free(copy);
+    return keys;
+}
+
+// whether keys are more than a plain first column, and so must be compared with keys_compare() on raw headers
+inlined bool keys_composite(keys_t *keys) {
+    return keys->size > 1 || keys->columns[0] != 0;
+}
+
+// check that row has every key column, at the size of its type
+inlined void keys_check(keys_t *keys, row_t *row) {
+    for (i32 i = 0; i < keys->size; i++) {
+        ASSERT(keys->columns[i] <= row->max, "fatal: row has no key column %d\n", keys->columns[i] + 1);
+        ASSERT_SIZE(keys->types[i], row->sizes[keys->columns[i]]);
+    }
+}
+
+// the raw header of a row, which directly precedes its columns
+inlined u8 *keys_header(row_t *row) {
+    return row->columns[0] - sizeof(u16) * (row->max + 2);
+}
+
+inlined u8 *keys_column(const u8 *header, i32 column) {
+    const u8 *value = header + sizeof(u16) * (FROM_UINT16(header) + 2);
+    for (i32 i = 0; i < column; i++)
+        value += FROM_UINT16(header + sizeof(u16) * (i + 1)) + 1;
+    return (u8*)value;
+}
+
+// the u64 key of the first field of a row, see radix_key_of()
+inlined u64 keys_first(keys_t *keys, const u8 *header) {
+    return radix_key_of(keys->types[0], keys_column(header, keys->columns[0]));
+}
+
+inlined int keys_compare(keys_t *keys, const u8 *h1, const u8 *h2) {
+    int cmp;
+    for (i32 i = 0; i < keys->size; i++) {
+        cmp = keys->compares[i](keys_column(h1, keys->columns[i]), keys_column(h2, keys->columns[i]));
+        if (cmp)
+            return cmp;
+    }
+    return 0;
+}
+
+// heap.h and sort.h take plain compare functions, so the keys they compare by are global
+keys_t sort_keys;
+
+int sort_keys_compare(const void *h1, const void *h2) {
+    return keys_compare(&sort_keys, h1, h2);
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "util.h"
+#include "radix.h"
+
+//
+// a loser tree for k-way merges. every internal node holds the input
+// that lost the match played there, so after the winner is replaced
+// only its path to the root is replayed, at one compare per level
+// instead of the two per level of a heap's delete and insert.
+//
+// each input keeps its current u64 key inline, from radix_key_of(), so
+// most matches are settled without touching the rows. when the key is
+// exact, equal keys are equal rows, otherwise ties go to compare() on
+// the inputs' values. remaining ties go to the lower input.
+//
+// the tree is implicit: inputs are leaves size..2*size-1, node n has
+// children 2n and 2n+1, and node 0 holds the overall winner.
+//
+
+typedef struct losertree_s {
+    i32 size;
+    i32 *tree;
+    radix_t *inputs;
+    bool *done;
+    bool exact;
+    compare_fn_t compare;
+} losertree_t;
+
+losertree_t losertree_init(i32 size, bool exact, compare_fn_t compare) {
+    losertree_t lt;
+    lt.size = size;
+    lt.exact = exact;
+    lt.compare = compare;
+    MALLOC(lt.tree, sizeof(i32) * MAX(1, size));
+    MALLOC(lt.inputs, sizeof(radix_t) * MAX(1, size));
+    MALLOC(lt.done, sizeof(bool) * MAX(1, size));
+    for (i32 i = 0; i < size; i++)
+        lt.done[i] = true;
+    return lt;
+}
+
+void losertree_free(losertree_t *lt) {
+    free(lt->tree);
+    free(lt->inputs);
+    free(lt->done);
+}
+
+// whether input a is merged before input b
+inlined bool losertree_before(losertree_t *lt, i32 a, i32 b) {
+    int cmp;
+    if (lt->done[b])
+        return !lt->done[a] || a < b;
+    if (lt->done[a])
+        return false;
+    if (lt->inputs[a].key != lt->inputs[b].key)
+        return lt->inputs[a].key < lt->inputs[b].key;
+    if (!lt->exact && (cmp = lt->compare(lt->inputs[a].val, lt->inputs[b].val)))
+        return cmp < 0;
+    return a < b;
+}
+
+// set the current value of an input, before losertree_build() or after it wins
+inlined void losertree_set(losertree_t *lt, i32 input, u64 key, void *val) {
+    lt->inputs[input].key = key;
+    lt->inputs[input].val = val;
+    lt->done[input] = false;
+}
+
+// mark an input as exhausted, before losertree_build() or after it wins
+inlined void losertree_done(losertree_t *lt, i32 input) {
+    lt->done[input] = true;
+}
+
+// replay the path from input to the root
+inlined void losertree_replay(losertree_t *lt, i32 input) {
+    i32 winner = input;
+    i32 tmp;
+    for (i32 node = (input + lt->size) / 2; node > 0; node /= 2) {
+        if (losertree_before(lt, lt->tree[node], winner)) {
+            tmp = lt->tree[node];
+            lt->tree[node] = winner;
+            winner = tmp;
+        }
+    }
+    lt->tree[0] = winner;
+}
+
+// play every match once the inputs are set
+void losertree_build(losertree_t *lt) {
+    i32 winner;
+    i32 node;
+    i32 tmp;
+    for (i32 i = 0; i < lt->size; i++)
+        lt->tree[i] = -1;
+    for (i32 i = 0; i < lt->size; i++) {
+        winner = i;
+        for (node = (i + lt->size) / 2; node > 0; node /= 2) {
+            if (lt->tree[node] == -1) { // ---------------------------------------------------------- first to arrive waits here for its opponent
+                lt->tree[node] = winner;
+                break;
+            }
+            if (losertree_before(lt, lt->tree[node], winner)) {
+                tmp = lt->tree[node];
+                lt->tree[node] = winner;
+                winner = tmp;
+            }
+        }
+        if (node == 0)
+            lt->tree[0] = winner;
+    }
+}
+
+// the input whose value is next, or -1 when every input is done
+inlined i32 losertree_winner(losertree_t *lt) {
+    if (!lt->size || lt->done[lt->tree[0]])
+        return -1;
+    return lt->tree[0];
+}
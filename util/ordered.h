@@ -0,0 +1,114 @@
+#pragma once
+
+#include "util.h"
+#include "thread.h"
+#include "stats.h"
+
+//
+// an ordered chunk pipeline. the caller reads chunks sequentially into
+// slots, worker threads transform them in any order, and the caller
+// writes them back out in the order they were read. the slots form a
+// reorder buffer, so at most num_slots chunks are in flight at once.
+//
+// see blz4.c for example usage.
+//
+
+typedef struct ordered_chunk_s {
+    i32 size; // --------------------------------- uncompressed size of the chunk
+    i32 header; // ------------------------------- chunk size tagged with codec and flags
+    u64 checksum;
+    u8 *stats; // -------------------------------- chunk stats, if any, passed through as they are
+    i32 stats_size;
+    u8 *in;
+    i32 in_size;
+    u8 *out;
+    i32 out_size;
+    bool done;
+} ordered_chunk_t;
+
+typedef struct ordered_s {
+    ordered_chunk_t *slots;
+    i32 num_slots;
+    u64 submitted; // ---------------------------- chunks handed to workers
+    u64 taken; // -------------------------------- chunks picked up by workers
+    u64 written; // ------------------------------ chunks passed to the write callback
+    void (*work)(ordered_chunk_t *chunk);
+    void (*write)(ordered_chunk_t *chunk);
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t *workers;
+} ordered_t;
+
+void *ordered_worker(void *arg) {
+    ordered_t *o = arg;
+    ordered_chunk_t *chunk;
+    while (1) {
+        MUTEX_LOCK(o->lock);
+        while (o->taken == o->submitted)
+            COND_WAIT(o->cond, o->lock);
+        chunk = &o->slots[o->taken++ % o->num_slots];
+        MUTEX_UNLOCK(o->lock);
+        o->work(chunk);
+        MUTEX_LOCK(o->lock);
+        chunk->done = true;
+        COND_BROADCAST(o->cond);
+        MUTEX_UNLOCK(o->lock);
+    }
+    return NULL;
+}
+
+ordered_t *ordered_init(i32 num_workers, i32 in_size, i32 out_size, void (*work)(ordered_chunk_t*), void (*write)(ordered_chunk_t*)) {
+    ASSERT(num_workers > 0, "fatal: number of workers must be positive, got: %d\n", num_workers);
+    ordered_t *o;
+    MALLOC(o, sizeof(ordered_t));
+    o->num_slots = num_workers * 2;
+    o->submitted = 0;
+    o->taken = 0;
+    o->written = 0;
+    o->work = work;
+    o->write = write;
+    MALLOC(o->slots, sizeof(ordered_chunk_t) * o->num_slots);
+    for (i32 i = 0; i < o->num_slots; i++) {
+        MALLOC(o->slots[i].in, in_size);
+        MALLOC(o->slots[i].out, out_size);
+        MALLOC(o->slots[i].stats, STATS_MAX_SIZE);
+        o->slots[i].done = false;
+    }
+    ASSERT(0 == pthread_mutex_init(&o->lock, NULL), "fatal: pthread_mutex_init\n");
+    ASSERT(0 == pthread_cond_init(&o->cond, NULL), "fatal: pthread_cond_init\n");
+    MALLOC(o->workers, sizeof(pthread_t) * num_workers);
+    for (i32 i = 0; i < num_workers; i++)
+        THREAD_CREATE(o->workers[i], ordered_worker, o);
+    return o;
+}
+
+// write the oldest chunk in flight once a worker is done with it
+void ordered_write_oldest(ordered_t *o) {
+    ordered_chunk_t *chunk = &o->slots[o->written % o->num_slots];
+    MUTEX_LOCK(o->lock);
+    while (!chunk->done)
+        COND_WAIT(o->cond, o->lock);
+    MUTEX_UNLOCK(o->lock);
+    o->write(chunk);
+    chunk->done = false;
+    o->written++;
+}
+
+// return the next free slot to read a chunk into, writing out finished chunks if the reorder buffer is full
+ordered_chunk_t *ordered_next(ordered_t *o) {
+    if (o->submitted - o->written == o->num_slots)
+        ordered_write_oldest(o);
+    return &o->slots[o->submitted % o->num_slots];
+}
+
+void ordered_submit(ordered_t *o) {
+    MUTEX_LOCK(o->lock);
+    o->submitted++;
+    COND_BROADCAST(o->cond);
+    MUTEX_UNLOCK(o->lock);
+}
+
+void ordered_finish(ordered_t *o) {
+    while (o->written < o->submitted)
+        ordered_write_oldest(o);
+}
@@ -0,0 +1,175 @@
+#include "util.h"
+#include "thread.h"
+
+//
+// a parallel stable sort. the array is cut into one contiguous slice
+// per job, the slices are sorted concurrently with PSORT_SORT, and then
+// merged pairwise in rounds until one run is left.
+//
+// every merge is split across the jobs by merge path: for each job's
+// share of the output, a binary search along the diagonal finds where
+// that share starts in both inputs, so jobs merge disjoint ranges with
+// no coordination and all of them stay busy through the last round.
+// ties always take from the left run, which keeps the result stable.
+//
+// like sort.h, it is instantiated by defining its parameters first:
+//
+// #define PSORT_NAME row
+// #define PSORT_TYPE raw_row_t *
+// #define PSORT_CMP(x, y) compare((x)->meta, (x)->buffer, (y)->buffer)
+// #define PSORT_SORT row_tim_sort // ----- any stable sort of (PSORT_TYPE *array, size_t size)
+// #include "psort.h"
+//
+// which defines row_psort(array, size, jobs).
+//
+
+#ifndef PSORT_NAME
+#error "Must declare PSORT_NAME"
+#endif
+
+#define PSORT_CONCAT1(a, b) a##_##b
+#define PSORT_CONCAT(a, b) PSORT_CONCAT1(a, b)
+#define PSORT_FN(x) PSORT_CONCAT(PSORT_NAME, x)
+
+typedef struct {
+    PSORT_TYPE *src;
+    PSORT_TYPE *dst;
+    u64 a; // ------------------------------------ left run, as offsets into src
+    u64 a_size;
+    u64 b; // ------------------------------------ right run, which directly follows the left
+    u64 b_size;
+    u64 start; // -------------------------------- share of the merged output to produce
+    u64 end;
+} PSORT_FN(psort_task_t);
+
+void *PSORT_FN(psort_slice)(void *arg) {
+    PSORT_FN(psort_task_t) *t = arg;
+    PSORT_SORT(t->src + t->a, t->a_size);
+    return NULL;
+}
+
+// return how many elements of a are in the first d elements of the stable merge of a and b
+inlined u64 PSORT_FN(psort_split)(PSORT_TYPE *a, u64 a_size, PSORT_TYPE *b, u64 b_size, u64 d) {
+    u64 lo = d > b_size ? d - b_size : 0;
+    u64 hi = d < a_size ? d : a_size;
+    u64 mid;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (PSORT_CMP(a[mid], b[d - mid - 1]) <= 0) // ------------------------------------------- a[mid] is merged before b[d - mid - 1], so it is within the first d
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+void *PSORT_FN(psort_merge)(void *arg) {
+    PSORT_FN(psort_task_t) *t = arg;
+    PSORT_TYPE *a = t->src + t->a;
+    PSORT_TYPE *b = t->src + t->b;
+    PSORT_TYPE *dst = t->dst + t->a + t->start;
+    u64 i = PSORT_FN(psort_split)(a, t->a_size, b, t->b_size, t->start);
+    u64 j = t->start - i;
+    u64 i_end = PSORT_FN(psort_split)(a, t->a_size, b, t->b_size, t->end);
+    u64 j_end = t->end - i_end;
+    while (i < i_end && j < j_end) {
+        if (PSORT_CMP(a[i], b[j]) <= 0)
+            *dst++ = a[i++];
+        else
+            *dst++ = b[j++];
+    }
+    memcpy(dst, a + i, (i_end - i) * sizeof(PSORT_TYPE));
+    dst += i_end - i;
+    memcpy(dst, b + j, (j_end - j) * sizeof(PSORT_TYPE));
+    return NULL;
+}
+
+void PSORT_FN(psort)(PSORT_TYPE *array, u64 size, i32 jobs) {
+    ASSERT(jobs > 0, "fatal: number of jobs must be positive, got: %d\n", jobs);
+    if (jobs == 1 || size < jobs * 2) {
+        PSORT_SORT(array, size);
+        return;
+    }
+    PSORT_TYPE *src = array;
+    PSORT_TYPE *dst;
+    PSORT_TYPE *tmp;
+    PSORT_FN(psort_task_t) *tasks;
+    pthread_t *threads;
+    u64 *bounds;
+    i32 runs = jobs;
+    i32 pairs;
+    i32 per_pair;
+    i32 num_tasks;
+    u64 a_size;
+    u64 b_size;
+    MALLOC(dst, sizeof(PSORT_TYPE) * size);
+    MALLOC(tasks, sizeof(PSORT_FN(psort_task_t)) * jobs);
+    MALLOC(threads, sizeof(pthread_t) * jobs);
+    MALLOC(bounds, sizeof(u64) * (jobs + 1));
+
+    // sort a slice per job
+    for (i32 i = 0; i <= jobs; i++)
+        bounds[i] = size * i / jobs;
+    for (i32 i = 0; i < jobs; i++) {
+        tasks[i].src = src;
+        tasks[i].a = bounds[i];
+        tasks[i].a_size = bounds[i + 1] - bounds[i];
+        THREAD_CREATE(threads[i], PSORT_FN(psort_slice), &tasks[i]);
+    }
+    for (i32 i = 0; i < jobs; i++)
+        THREAD_JOIN(threads[i]);
+
+    // merge runs pairwise, splitting every merge across the jobs, until one run is left
+    while (runs > 1) {
+        pairs = runs / 2;
+        per_pair = MAX(1, jobs / pairs);
+        num_tasks = 0;
+        for (i32 p = 0; p < pairs; p++) {
+            a_size = bounds[p * 2 + 1] - bounds[p * 2];
+            b_size = bounds[p * 2 + 2] - bounds[p * 2 + 1];
+            for (i32 i = 0; i < per_pair; i++) {
+                PSORT_FN(psort_task_t) *t = &tasks[num_tasks];
+                t->src = src;
+                t->dst = dst;
+                t->a = bounds[p * 2];
+                t->a_size = a_size;
+                t->b = bounds[p * 2 + 1];
+                t->b_size = b_size;
+                t->start = (a_size + b_size) * i / per_pair;
+                t->end = (a_size + b_size) * (i + 1) / per_pair;
+                THREAD_CREATE(threads[num_tasks], PSORT_FN(psort_merge), t);
+                num_tasks++;
+            }
+        }
+        if (runs % 2) // ------------------------------------------------------------------------ an odd run out has nothing to merge with this round
+            memcpy(dst + bounds[runs - 1], src + bounds[runs - 1], (size - bounds[runs - 1]) * sizeof(PSORT_TYPE));
+        for (i32 i = 0; i < num_tasks; i++)
+            THREAD_JOIN(threads[i]);
+        for (i32 p = 0; p < pairs; p++)
+            bounds[p] = bounds[p * 2];
+        if (runs % 2)
+            bounds[pairs] = bounds[runs - 1];
+        runs = (runs + 1) / 2;
+        bounds[runs] = size;
+        tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != array) {
+        memcpy(array, src, size * sizeof(PSORT_TYPE));
+        dst = src;
+    }
+    free(dst);
+    free(tasks);
+    free(threads);
+    free(bounds);
+}
+
+#undef PSORT_CONCAT1
+#undef PSORT_CONCAT
+#undef PSORT_FN
+#undef PSORT_NAME
+#undef PSORT_TYPE
+#undef PSORT_CMP
+#undef PSORT_SORT
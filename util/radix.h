@@ -0,0 +1,114 @@
+#pragma once
+
+#include "util.h"
+
+//
+// an lsd radix sort of (key, row) pairs, for the numeric value types.
+// every value is mapped to a u64 whose unsigned order is the order
+// compare() gives that type, so one sort handles them all:
+//
+// - signed ints flip their sign bit
+// - floats flip their sign bit when positive, and all bits when negative
+// - reversed types are subtracted from the max key of their width
+//
+// keys are never wider than their type, so a byte that is the same in
+// every key, like the high bytes of an i32, costs no pass.
+//
+// strings get a key too, from radix_prefix(), which lets a comparison
+// sort resolve most compares without leaving the key array.
+//
+
+typedef struct radix_s {
+    u64 key;
+    void *val;
+} radix_t;
+
+// true for the value types that radix_key() can map
+inlined bool radix_type(i32 value_type) {
+    return value_type != STR && value_type != R_STR;
+}
+
+inlined u64 radix_key(i32 value_type, const void *v) {
+    f64 f64_val;
+    f32 f32_val;
+    u64 key;
+    u32 bits;
+    switch (value_type) {
+        // normal
+        case I64: return *(u64*)v ^ ((u64)1 << 63);
+        case I32: return (u32)(*(u32*)v ^ ((u32)1 << 31));
+        case I16: return (u16)(*(u16*)v ^ ((u16)1 << 15));
+        case U64: return *(u64*)v;
+        case U32: return *(u32*)v;
+        case U16: return *(u16*)v;
+        case F64: f64_val = *(f64*)v;
+                  if (f64_val == 0) f64_val = 0; // --------------------------------------------------- -0.0 compares equal to 0.0, so it must key equal too
+                  memcpy(&key, &f64_val, sizeof(u64));
+                  return key >> 63 ? ~key : key ^ ((u64)1 << 63);
+        case F32: f32_val = *(f32*)v;
+                  if (f32_val == 0) f32_val = 0;
+                  memcpy(&bits, &f32_val, sizeof(u32));
+                  return bits >> 31 ? (u32)~bits : bits ^ ((u32)1 << 31);
+        // reverse
+        case R_I64: return UINT64_MAX - radix_key(I64, v);
+        case R_I32: return UINT32_MAX - radix_key(I32, v);
+        case R_I16: return UINT16_MAX - radix_key(I16, v);
+        case R_U64: return UINT64_MAX - radix_key(U64, v);
+        case R_U32: return UINT32_MAX - radix_key(U32, v);
+        case R_U16: return UINT16_MAX - radix_key(U16, v);
+        case R_F64: return UINT64_MAX - radix_key(F64, v);
+        case R_F32: return UINT32_MAX - radix_key(F32, v);
+        default: ASSERT(0, "fatal: no radix key for type: %d\n", value_type);
+    }
+}
+
+// the first 8 bytes of a string, big endian, so keys order like simd_strcmp() except for ties, which need the whole strings
+inlined u64 radix_prefix(i32 value_type, const u8 *s) {
+    u64 key = 0;
+    for (i32 i = 0; i < sizeof(u64) && s[i]; i++)
+        key |= (u64)s[i] << (56 - i * 8);
+    return value_type == R_STR ? ~key : key;
+}
+
+// the key of any value type, which is exact for numbers and a prefix for strings
+inlined u64 radix_key_of(i32 value_type, const void *v) {
+    return radix_type(value_type) ? radix_key(value_type, v) : radix_prefix(value_type, v);
+}
+
+// stable sort of array by key
+void radix_sort(radix_t *array, u64 size) {
+    u64 counts[8][256] = {0};
+    u64 offsets[256];
+    u64 offset;
+    radix_t *src = array;
+    radix_t *dst;
+    radix_t *tmp;
+    u8 byte;
+    if (size < 2)
+        return;
+    for (u64 i = 0; i < size; i++)
+        for (i32 b = 0; b < 8; b++)
+            counts[b][(array[i].key >> (b * 8)) & 0xff]++;
+    MALLOC(dst, sizeof(radix_t) * size);
+    for (i32 b = 0; b < 8; b++) {
+        if (counts[b][(array[0].key >> (b * 8)) & 0xff] == size) // -------------------------------- every key has this byte, so this pass would change nothing
+            continue;
+        offset = 0;
+        for (i32 i = 0; i < 256; i++) {
+            offsets[i] = offset;
+            offset += counts[b][i];
+        }
+        for (u64 i = 0; i < size; i++) {
+            byte = (src[i].key >> (b * 8)) & 0xff;
+            dst[offsets[byte]++] = src[i];
+        }
+        tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+    if (src != array) {
+        memcpy(array, src, sizeof(radix_t) * size);
+        dst = src;
+    }
+    free(dst);
+}
@@ -1,7 +1,16 @@
 #pragma once
 
 #include "util.h"
-#include "lz4.h"
+#include "thread.h"
+#include "codec.h"
+#include "stats.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// how far past the current chunk to ask the kernel to prefetch when reading via mmap
+#define MMAP_WILLNEED_SIZE BUFFER_SIZE * 4
+
+typedef struct prefetch_s prefetch_t;
 
 typedef struct readbuf_s {
     // public
@@ -9,70 +18,453 @@ typedef struct readbuf_s {
     i32 bytes;
     // private
     FILE **files;
+    i32 num_files;
     u8 **buffers;
     i32 bytes_left;
-    i32 bytes_read;
     i32 *offset;
     i32 *chunk_size;
     bool lz4;
-    u8 *lz4_buf;
-    i32 lz4_size;
+    u8 *codec_buf;
+    u8 **mmaps;
+    i64 *mmap_size;
+    i64 *mmap_offset;
+    u8 **spares;
+    u8 *spare_next;
+    prefetch_t **prefetch;
+    i32 *header; // ------------------------------ header of the chunk being read, or peeked at by read_peek()
+    bool *peeked;
+    i64 *chunk_start;
+    chunk_stats_t *stats; // --------------------- stats of the chunk being read, if it has any
+    u8 **stats_buf;
+    u8 *skip_buf;
+    // options
+    bool verify; // ------------------------------ check chunk checksums, on by default
 } readbuf_t;
 
+// regular files are read through a mapping, anything else like a pipe falls back to fread
+void rbuf_mmap(readbuf_t *buf, i32 file) {
+    struct stat st;
+    buf->mmaps[file] = NULL;
+    i32 fd = fileno(buf->files[file]);
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        return;
+    i64 start = ftello(buf->files[file]); // ---------------------------------- the file may have already been partially consumed
+    if (start < 0 || start >= st.st_size)
+        return;
+    u8 *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+        return;
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    buf->mmaps[file] = map;
+    buf->mmap_size[file] = st.st_size;
+    buf->mmap_offset[file] = start;
+}
+
 readbuf_t rbuf_init(FILE **files, i32 num_files, bool lz4) {
     readbuf_t *buf;
     MALLOC(buf, sizeof(readbuf_t));
     buf->files = files;
+    buf->num_files = num_files;
     MALLOC(buf->buffers, sizeof(u8*) * num_files);
     MALLOC(buf->offset, sizeof(i32) * num_files);
     MALLOC(buf->chunk_size, sizeof(i32) * num_files);
+    MALLOC(buf->mmaps, sizeof(u8*) * num_files);
+    MALLOC(buf->mmap_size, sizeof(i64) * num_files);
+    MALLOC(buf->mmap_offset, sizeof(i64) * num_files);
+    MALLOC(buf->spares, sizeof(u8*) * num_files * 2);
+    MALLOC(buf->spare_next, sizeof(u8) * num_files);
+    MALLOC(buf->header, sizeof(i32) * num_files);
+    MALLOC(buf->peeked, sizeof(bool) * num_files);
+    MALLOC(buf->chunk_start, sizeof(i64) * num_files);
+    MALLOC(buf->stats, sizeof(chunk_stats_t) * num_files);
+    MALLOC(buf->stats_buf, sizeof(u8*) * num_files);
+    buf->skip_buf = NULL;
+    buf->prefetch = NULL;
+    buf->verify = true;
+    buf->lz4 = lz4;
     for (i32 i = 0; i < num_files; i++) {
       buf->chunk_size[i] = BUFFER_SIZE;
       buf->offset[i] = BUFFER_SIZE;
-      MALLOC(buf->buffers[i], BUFFER_SIZE);
+      buf->spares[i * 2] = NULL;
+      buf->spares[i * 2 + 1] = NULL;
+      buf->spare_next[i] = 0;
+      buf->peeked[i] = false;
+      buf->stats[i].type = NO_STATS;
+      buf->stats_buf[i] = NULL;
+      rbuf_mmap(buf, i);
+      if (buf->mmaps[i] && !lz4) // ------------------------------------------- zero copy reads point buffers into the mapping
+          buf->buffers[i] = NULL;
+      else
+          MALLOC(buf->buffers[i], BUFFER_SIZE);
     }
-    buf->lz4 = lz4;
-    if (lz4)
-        MALLOC(buf->lz4_buf, BUFFER_SIZE_LZ4);
+    MALLOC(buf->codec_buf, BUFFER_SIZE_LZ4); // ------------------------------- any chunk may be compressed, so always have scratch space for it
     return *buf;
 }
 
-#define DECOMPRESS(buf)                                                                                             \
-    do {                                                                                                            \
-        i32 decompressed_size = LZ4_decompress_safe(buf->lz4_buf, buf->buffers[file], buf->lz4_size, BUFFER_SIZE);  \
-        ASSERT(buf->chunk_size[file] == decompressed_size, "fatal: decompress size mismatch\n");                    \
-    } while(0)
+// release what rbuf_init() allocated and unmap the files, which are left open. under READ_GROWING, chunks belong to the caller.
+void rbuf_free(readbuf_t *buf) {
+    ASSERT(!buf->prefetch, "fatal: cannot free a readbuf with prefetch\n");
+    for (i32 i = 0; i < buf->num_files; i++) {
+        #ifndef READ_GROWING
+        if (!buf->mmaps[i] || buf->lz4)
+            free(buf->buffers[i]);
+        #endif
+        if (buf->mmaps[i])
+            munmap(buf->mmaps[i], buf->mmap_size[i]);
+        free(buf->spares[i * 2]);
+        free(buf->spares[i * 2 + 1]);
+        free(buf->stats_buf[i]);
+    }
+    free(buf->buffers);
+    free(buf->offset);
+    free(buf->chunk_size);
+    free(buf->mmaps);
+    free(buf->mmap_size);
+    free(buf->mmap_offset);
+    free(buf->spares);
+    free(buf->spare_next);
+    free(buf->header);
+    free(buf->peeked);
+    free(buf->chunk_start);
+    free(buf->stats);
+    free(buf->stats_buf);
+    free(buf->skip_buf);
+    free(buf->codec_buf);
+}
+
+#define READ_ZERO_COPY(buf, file) (buf->mmaps[file] && !buf->lz4)
+
+// whether file is mapped and its next chunk is compressed, going by the codec in its header rather than by the lz4 flag
+inlined bool read_mapped_compressed(readbuf_t *buf, i32 file) {
+    i32 header;
+    if (!buf->mmaps[file] || buf->mmap_size[file] - buf->mmap_offset[file] < (i64)sizeof(i32))
+        return false;
+    memcpy(&header, buf->mmaps[file] + buf->mmap_offset[file], sizeof(i32));
+    return buf->lz4 || CHUNK_CODEC(header) != CODEC_NONE;
+}
+
+// whether chunk, once the buffer of file, was malloced rather than pointing into its mapping, so under READ_GROWING the caller owns it
+inlined bool read_owned(readbuf_t *buf, u8 *chunk, i32 file) {
+    return !buf->mmaps[file] || chunk < buf->mmaps[file] || chunk >= buf->mmaps[file] + buf->mmap_size[file];
+}
+#define READ_CHUNK_DONE(buf, file) ((buf)->offset[file] == (buf)->chunk_size[file])
+
+// compressed chunks of a zero copy file decompress into one of two spare buffers, alternating so the previous chunk stays valid for read_ahead.h
+inlined u8 *read_spare(readbuf_t *buf, i32 file) {
+    i32 i = file * 2 + buf->spare_next[file];
+    buf->spare_next[file] ^= 1;
+    if (!buf->spares[i])
+        MALLOC(buf->spares[i], BUFFER_SIZE);
+    return buf->spares[i];
+}
+
+// return a pointer to the next size bytes of the mapping and advance past them
+inlined u8 *mmap_read(readbuf_t *buf, i32 size, i32 file) {
+    i64 left = buf->mmap_size[file] - buf->mmap_offset[file];
+    ASSERT(size <= left, "fatal: failed to read input, expected %d got %d\n", size, (i32)left);
+    u8 *ptr = buf->mmaps[file] + buf->mmap_offset[file];
+    buf->mmap_offset[file] += size;
+    return ptr;
+}
+
+// hint the kernel to start reading the next few chunks while we process this one
+inlined void mmap_willneed(readbuf_t *buf, i32 file) {
+    i64 page = sysconf(_SC_PAGESIZE);
+    i64 start = buf->mmap_offset[file] & ~(page - 1);
+    i64 size = MIN(MMAP_WILLNEED_SIZE, buf->mmap_size[file] - start);
+    if (size > 0)
+        madvise(buf->mmaps[file] + start, size, MADV_WILLNEED);
+}
+
+inlined i32 read_chunk_size(readbuf_t *buf, i32 *size, i32 file) {
+    if (!buf->mmaps[file])
+        return fread_unlocked(size, 1, sizeof(i32), buf->files[file]);
+    if (buf->mmap_offset[file] == buf->mmap_size[file])
+        return 0;
+    memcpy(size, mmap_read(buf, sizeof(i32), file), sizeof(i32));
+    return sizeof(i32);
+}
+
+inlined void read_verify(readbuf_t *buf, i32 header, u64 hash, u8 *body, i32 size, i32 file) {
+    u64 stats_hash = header & CHUNK_STATS ? buf->stats[file].hash : 0;
+    ASSERT(!buf->verify || hash == chunk_checksum(header, stats_hash, body, size), "fatal: chunk checksum mismatch\n");
+}
+
+// read the checksum trailer of a chunk if it has one and check it against the chunk body
+inlined void read_checksum(readbuf_t *buf, i32 header, u8 *body, i32 size, i32 file) {
+    u64 hash;
+    if (header & CHUNK_CHECKSUM) {
+        if (buf->mmaps[file])
+            memcpy(&hash, mmap_read(buf, sizeof(u64), file), sizeof(u64));
+        else
+            FREAD(&hash, sizeof(u64), buf->files[file]);
+        read_verify(buf, header, hash, body, size, file);
+    }
+}
+
+// read the header of the next chunk of file, and its stats if it has any. returns false at eof.
+inlined bool read_header(readbuf_t *buf, i32 file) {
+    i32 header;
+    i32 size;
+    u8 *src;
+    if (buf->mmaps[file])
+        buf->chunk_start[file] = buf->mmap_offset[file];
+    switch (read_chunk_size(buf, &header, file)) { // --------------------------------------------------- try read chunk size
+        case sizeof(i32): // ------------------------------------------------------------------------------ read chunk size succeeded
+            break;
+        case 0: // ---------------------------------------------------------------------------------------- read chunk size failed
+            ASSERT(buf->mmaps[file] || !ferror_unlocked(buf->files[file]), "fatal: read error\n");
+            return false;
+        default:
+            ASSERT(0, "fatal: impossible\n");
+    }
+    ASSERT(CHUNK_VALID(header), "fatal: bad chunk size: %d\n", header);
+    buf->header[file] = header;
+    buf->stats[file].type = NO_STATS;
+    if (header & CHUNK_STATS) {
+        if (buf->mmaps[file]) {
+            src = mmap_read(buf, STATS_HEADER_SIZE, file);
+            size = stats_length(src);
+            mmap_read(buf, size - STATS_HEADER_SIZE, file); // ----------------------------------------------- the rest of the stats follow in the mapping
+        } else {
+            if (!buf->stats_buf[file])
+                MALLOC(buf->stats_buf[file], STATS_MAX_SIZE);
+            src = buf->stats_buf[file];
+            size = stats_read(src, buf->files[file]);
+        }
+        stats_parse(&buf->stats[file], src, size);
+    }
+    return true;
+}
+
+//
+// read the header and stats of the next chunk of file without reading
+// the rest of it, and return false at eof. the chunk is then either read
+// as usual, or passed over by read_skip(). only call this between
+// chunks, see READ_CHUNK_DONE(), and never with prefetch.
+//
+inlined bool read_peek(readbuf_t *buf, i32 file) {
+    ASSERT(!buf->prefetch || !buf->prefetch[file], "fatal: cannot peek at chunks with prefetch\n");
+    if (!buf->peeked[file]) {
+        if (!read_header(buf, file))
+            return false;
+        buf->peeked[file] = true;
+    }
+    return true;
+}
+
+// pass over the chunk just peeked at without decompressing or parsing it, and point *raw at its bytes as they are in the input. returns their size.
+inlined i32 read_skip(readbuf_t *buf, u8 **raw, i32 file) {
+    i32 header = buf->header[file];
+    i32 codec = CHUNK_CODEC(header);
+    i32 size = CHUNK_SIZE(header);
+    i32 offset;
+    u64 hash;
+    u8 *body;
+    ASSERT(buf->peeked[file], "fatal: read_skip without read_peek\n");
+    buf->peeked[file] = false;
+    if (codec == CODEC_NONE && buf->lz4)
+        codec = CODEC_LZ4;
+    if (buf->mmaps[file]) {
+        if (codec != CODEC_NONE)
+            memcpy(&size, mmap_read(buf, sizeof(i32), file), sizeof(i32));
+        ASSERT(0 <= size && size <= BUFFER_SIZE_LZ4, "fatal: bad compressed chunk size: %d\n", size);
+        body = mmap_read(buf, size, file);
+        read_checksum(buf, header, body, size, file);
+        mmap_willneed(buf, file);
+        *raw = buf->mmaps[file] + buf->chunk_start[file];
+        return buf->mmap_offset[file] - buf->chunk_start[file];
+    }
+    if (!buf->skip_buf)
+        MALLOC(buf->skip_buf, sizeof(i32) * 2 + STATS_MAX_SIZE + BUFFER_SIZE_LZ4 + sizeof(u64));
+    memcpy(buf->skip_buf, &header, sizeof(i32)); // ------------------------------------------------------ put the chunk back together as it was in the input
+    offset = sizeof(i32);
+    if (header & CHUNK_STATS) {
+        i32 stats_size = stats_length(buf->stats_buf[file]);
+        memcpy(buf->skip_buf + offset, buf->stats_buf[file], stats_size);
+        offset += stats_size;
+    }
+    if (codec != CODEC_NONE) {
+        FREAD(&size, sizeof(i32), buf->files[file]);
+        ASSERT(0 <= size && size <= BUFFER_SIZE_LZ4, "fatal: bad compressed chunk size: %d\n", size);
+        memcpy(buf->skip_buf + offset, &size, sizeof(i32));
+        offset += sizeof(i32);
+    }
+    body = buf->skip_buf + offset;
+    FREAD(body, size, buf->files[file]);
+    offset += size;
+    if (header & CHUNK_CHECKSUM) {
+        FREAD(&hash, sizeof(u64), buf->files[file]);
+        memcpy(buf->skip_buf + offset, &hash, sizeof(u64));
+        offset += sizeof(u64);
+        read_verify(buf, header, hash, body, size, file);
+    }
+    *raw = buf->skip_buf;
+    return offset;
+}
+
+//
+// read the next chunk of file into *dst and return its size, or -1 at
+// eof. zero copy reads point *dst into the mapping instead. codec_buf
+// is scratch space for compressed bytes, and is unused when mmapped.
+//
+inlined i32 read_chunk(readbuf_t *buf, u8 **dst, u8 *codec_buf, i32 file) {
+    i32 header;
+    i32 size;
+    i32 codec;
+    i32 compressed_size;
+    u8 *src;
+    if (!buf->peeked[file] && !read_header(buf, file)) // ------------------------------------------------ a peeked at header has already been read
+        return -1;
+    buf->peeked[file] = false;
+    header = buf->header[file];
+    codec = CHUNK_CODEC(header);
+    size = CHUNK_SIZE(header);
+    if (codec == CODEC_NONE && buf->lz4) // ------------------------------------------------------------ untagged chunks are legacy lz4 when asked for
+        codec = CODEC_LZ4;
+    if (codec == CODEC_NONE && READ_ZERO_COPY(buf, file)) {
+        *dst = mmap_read(buf, size, file); // ----------------------------------------------------------------- point at the chunk body, the mapping outlives every chunk so READ_GROWING needs no copy
+        read_checksum(buf, header, *dst, size, file);
+        mmap_willneed(buf, file);
+        return size;
+    }
+    #ifdef READ_GROWING // when defined hold all data in ram for sorting
+        MALLOC(*dst, size);
+    #else
+        if (READ_ZERO_COPY(buf, file) && !(buf->prefetch && buf->prefetch[file]))
+            *dst = read_spare(buf, file); // --------------------------------------------------------------- *dst may point into the mapping, which is read only. prefetch passes its own slot instead
+    #endif
+    if (codec != CODEC_NONE) {
+        if (buf->mmaps[file])
+            memcpy(&compressed_size, mmap_read(buf, sizeof(i32), file), sizeof(i32)); // ------------------- read compressed size
+        else
+            FREAD(&compressed_size, sizeof(i32), buf->files[file]);
+        ASSERT(0 <= compressed_size && compressed_size <= BUFFER_SIZE_LZ4, "fatal: bad compressed chunk size: %d\n", compressed_size);
+        if (buf->mmaps[file])
+            src = mmap_read(buf, compressed_size, file); // ----------------------------------------------- decompress straight from the mapping
+        else {
+            FREAD(codec_buf, compressed_size, buf->files[file]); // --------------------------------------- read compressed chunk
+            src = codec_buf;
+        }
+        read_checksum(buf, header, src, compressed_size, file); // -------------------------------------- verify before decompressing so corruption never reaches the decoder
+        codec_decompress(codec, src, compressed_size, *dst, size);
+    } else {
+        FREAD(*dst, size, buf->files[file]); // ---------------------------------------------------------- read the chunk body
+        read_checksum(buf, header, *dst, size, file);
+    }
+    if (buf->mmaps[file])
+        mmap_willneed(buf, file);
+    return size;
+}
+
+//
+// prefetch keeps up to depth chunks of a file read and decompressed
+// ahead of the consumer on a background thread. chunks are handed over
+// through a single producer single consumer ring whose slots are
+// counted by a pair of semaphores, so neither side takes a lock and
+// either side only sleeps when the ring is full or empty.
+//
+// the ring has depth + 1 slots, but only depth are ever counted as
+// empty. the consumer gives back each slot as soon as it takes it, and
+// the spare slot keeps the producer from reaching the one still being
+// read, so the producer can be a full depth chunks ahead. memory from
+// the previous chunk is invalid after asking for the next, which
+// matches what load_next() already promises.
+//
+struct prefetch_s {
+    readbuf_t *buf;
+    i32 file;
+    i32 num_slots; // ---------------------------- depth + 1
+    u8 **slots; // ------------------------------- malloced, one per ring slot
+    u8 **buffers; // ----------------------------- what each slot holds, its own buffer or a plain chunk in the mapping
+    i32 *sizes;
+    i32 head;
+    i32 tail;
+    bool done;
+    u8 *codec_buf;
+    sem_t filled;
+    sem_t empty;
+    pthread_t thread;
+};
+
+void *prefetch_producer(void *arg) {
+    prefetch_t *p = arg;
+    i32 size;
+    u8 *dst;
+    do {
+        SEM_WAIT(p->empty);
+        dst = p->slots[p->head]; // -------------------------------------------- reset every time, since a plain chunk of a mapped file points dst into the mapping
+        size = read_chunk(p->buf, &dst, p->codec_buf, p->file);
+        p->buffers[p->head] = dst;
+        p->sizes[p->head] = size;
+        p->head = (p->head + 1) % p->num_slots;
+        SEM_POST(p->filled);
+    } while (size != -1);
+    return NULL;
+}
+
+// start a read ahead thread for every file. opt-in since it costs depth + 1 chunks of ram per file.
+void rbuf_prefetch(readbuf_t *buf, i32 depth) {
+    ASSERT(depth > 0, "fatal: prefetch depth must be positive, got: %d\n", depth);
+    MALLOC(buf->prefetch, sizeof(prefetch_t*) * buf->num_files);
+    for (i32 i = 0; i < buf->num_files; i++) {
+        buf->prefetch[i] = NULL;
+        if (buf->mmaps[i] && !read_mapped_compressed(buf, i)) // ---------------- plain mapped files already get read ahead by the kernel, but compressed ones still need decompressing ahead
+            continue;
+        prefetch_t *p;
+        MALLOC(p, sizeof(prefetch_t));
+        p->buf = buf;
+        p->file = i;
+        p->num_slots = depth + 1;
+        p->head = 0;
+        p->tail = 0;
+        p->done = false;
+        MALLOC(p->slots, sizeof(u8*) * p->num_slots);
+        MALLOC(p->buffers, sizeof(u8*) * p->num_slots);
+        MALLOC(p->sizes, sizeof(i32) * p->num_slots);
+        for (i32 j = 0; j < p->num_slots; j++)
+            MALLOC(p->slots[j], BUFFER_SIZE);
+        MALLOC(p->codec_buf, BUFFER_SIZE_LZ4);
+        SEM_INIT(p->filled, 0);
+        SEM_INIT(p->empty, depth);
+        buf->prefetch[i] = p;
+        THREAD_CREATE(p->thread, prefetch_producer, p);
+    }
+}
+
+inlined i32 prefetch_next(readbuf_t *buf, i32 file) {
+    prefetch_t *p = buf->prefetch[file];
+    if (p->done)
+        return -1;
+    SEM_WAIT(p->filled);
+    i32 size = p->sizes[p->tail];
+    buf->buffers[file] = p->buffers[p->tail];
+    p->tail = (p->tail + 1) % p->num_slots;
+    SEM_POST(p->empty); // ----------------------------------------------------- the producer can only refill this slot after the spare one, so it stays ours until the next call
+    if (size == -1) {
+        p->done = true;
+        THREAD_JOIN(p->thread);
+    }
+    return size;
+}
 
 inlined void read_bytes(readbuf_t *buf, i32 size, i32 file) {
     buf->bytes_left = buf->chunk_size[file] - buf->offset[file]; // ------------------------------------ bytes left in the current chunk
     buf->bytes = size;
     ASSERT(buf->bytes_left >= 0, "fatal: negative bytes_left: %d\n", buf->bytes_left);
     if (buf->bytes_left == 0) { // --------------------------------------------------------------------- time to read the next chunk
-        buf->bytes_read = fread_unlocked(&buf->chunk_size[file], 1, sizeof(i32), buf->files[file]); // - try read chunk size
-        switch (buf->bytes_read) {
-            case sizeof(i32): // ----------------------------------------------------------------------- read chunk size succeeded
-                ASSERT(buf->chunk_size[file] <= BUFFER_SIZE, "fatal: bad chunk size: %d\n", buf->chunk_size[file]);
-                #ifdef READ_GROWING // when defined hold all data in ram for sorting
-                    MALLOC(buf->buffers[file], buf->chunk_size[file]);
-                #endif
-                if (buf->lz4) {
-                    FREAD(&buf->lz4_size, sizeof(i32), buf->files[file]); // --------------------------- read compressed size
-                    FREAD(buf->lz4_buf, buf->lz4_size, buf->files[file]); // --------------------------- read compressed chunk
-                    DECOMPRESS(buf);
-                } else
-                    FREAD(buf->buffers[file], buf->chunk_size[file], buf->files[file]); // ------------- read the chunk body
-                buf->offset[file] = 0; // -------------------------------------------------------------- start at the beggining of the new chunk
-                buf->bytes_left = buf->chunk_size[file]; // -------------------------------------------- bytes_left is the new chunk size
-                ASSERT(size <= buf->bytes_left, "fatal: diskread, not possible, chunk sizes are known\n");
-                break;
-            case 0: // --------------------------------------------------------------------------------- read chunk size failed
-                ASSERT(!ferror_unlocked(buf->files[file]), "fatal: read error\n");
-                buf->chunk_size[file] = 0;
-                buf->offset[file] = 0;
-                buf->bytes = 0;
-                break;
-            default:
-                ASSERT(0, "fatal: impossible\n");
+        if (buf->prefetch && buf->prefetch[file])
+            buf->chunk_size[file] = prefetch_next(buf, file); // ------------------------------------------ take the next chunk from the read ahead thread
+        else
+            buf->chunk_size[file] = read_chunk(buf, &buf->buffers[file], buf->codec_buf, file); // -------- read the next chunk
+        if (buf->chunk_size[file] == -1) { // ---------------------------------------------------------- empty read means EOF
+            buf->chunk_size[file] = 0;
+            buf->offset[file] = 0;
+            buf->bytes = 0;
+        } else {
+            buf->offset[file] = 0; // ------------------------------------------------------------------ start at the beggining of the new chunk
+            buf->bytes_left = buf->chunk_size[file]; // ------------------------------------------------ bytes_left is the new chunk size
+            ASSERT(size <= buf->bytes_left, "fatal: diskread, not possible, chunk sizes are known\n");
         }
     } else
         ASSERT(size <= buf->bytes_left, "fatal: ramread, not possible, chunk sizes are known\n");
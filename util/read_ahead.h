@@ -3,11 +3,21 @@
 #include "read.h"
 #include "util.h"
 
+//
+// step back to the chunk before the one being read. the previous chunk
+// is kept by pointer: zero copy reads leave it in the mapping or a spare
+// buffer, which outlive the next chunk, and other reads swap it into
+// last_buffers, which read_ahead owns. going back joins both chunks in
+// scratch, which read_ahead also owns and grows as needed.
+//
+
 typedef struct readaheadbuf_s {
     i32 has_nexted;
-    u8 **last_buffers;
+    u8 **last_buffers; // ------------------------ owned, swapped with the readbuf's buffers when it is not zero copy
+    u8 **last_chunks; // ------------------------- the previous chunk, in last_buffers or, when zero copy, wherever read_chunk() put it
     i32 *last_chunk_size;
-    i32 _i32;
+    u8 **scratch; // ----------------------------- owned, the previous and current chunk joined by read_goto_last_chunk()
+    i32 *scratch_size;
     u8 * _u8s;
 } readaheadbuf_t;
 
@@ -16,26 +26,32 @@ readaheadbuf_t rabuf_init(i32 num_files) {
     MALLOC(buf, sizeof(readaheadbuf_t));
     buf->has_nexted = 0;
     MALLOC(buf->last_buffers, sizeof(u8*) * num_files);
+    MALLOC(buf->last_chunks, sizeof(u8*) * num_files);
     MALLOC(buf->last_chunk_size, sizeof(i32) * num_files);
+    MALLOC(buf->scratch, sizeof(u8*) * num_files);
+    MALLOC(buf->scratch_size, sizeof(i32) * num_files);
     for (i32 i = 0; i < num_files; i++) {
       MALLOC(buf->last_buffers[i], BUFFER_SIZE);
+      buf->scratch[i] = NULL;
+      buf->scratch_size[i] = 0;
     }
     return *buf;
 }
 
 inlined void swap(readbuf_t *rbuf, readaheadbuf_t* rabuf, i32 file) {
-    // swap buffers
     rabuf->_u8s = rbuf->buffers[file];
     rbuf->buffers[file] = rabuf->last_buffers[file];
     rabuf->last_buffers[file] = rabuf->_u8s;
-    // swap chunk sizes
-    rabuf->_i32 = rbuf->chunk_size[file];
-    rbuf->chunk_size[file] = rabuf->last_chunk_size[file];
-    rabuf->last_chunk_size[file] = rabuf->_i32;
 }
 
 inlined void read_goto_next_chunk(readbuf_t *rbuf, readaheadbuf_t* rabuf, i32 file) {
-    swap(rbuf, rabuf, file);
+    if (READ_ZERO_COPY(rbuf, file)) {
+        rabuf->last_chunks[file] = rbuf->buffers[file];
+    } else {
+        swap(rbuf, rabuf, file);
+        rabuf->last_chunks[file] = rabuf->last_buffers[file];
+    }
+    rabuf->last_chunk_size[file] = rbuf->chunk_size[file];
     rbuf->offset[file] = rbuf->chunk_size[file];
     rabuf->has_nexted = 1;
 }
@@ -44,9 +60,22 @@ inlined void read_goto_last_chunk(readbuf_t *rbuf, readaheadbuf_t* rabuf, i32 fi
     rbuf->offset[file] = 0;
     if (rabuf->has_nexted) {
         // goto_last only does something if goto_next has been used, and results in: buffer = last_buf + current_buf
-        swap(rbuf, rabuf, file);
-        REALLOC(rbuf->buffers[file], rbuf->chunk_size[file] + rabuf->last_chunk_size[file]);
-        memcpy(rbuf->buffers[file] + rbuf->chunk_size[file], rabuf->last_buffers[file], rabuf->last_chunk_size[file]);
-        rbuf->chunk_size[file] += rabuf->last_chunk_size[file];
+        i32 size = rabuf->last_chunk_size[file] + rbuf->chunk_size[file];
+        i32 capacity = MAX(size, BUFFER_SIZE); // --------------------------------------------------------------- as big as any readbuf buffer, which it may become
+        if (capacity > rabuf->scratch_size[file]) {
+            REALLOC(rabuf->scratch[file], capacity);
+            rabuf->scratch_size[file] = capacity;
+        }
+        memcpy(rabuf->scratch[file], rabuf->last_chunks[file], rabuf->last_chunk_size[file]);
+        memcpy(rabuf->scratch[file] + rabuf->last_chunk_size[file], rbuf->buffers[file], rbuf->chunk_size[file]);
+        if (READ_ZERO_COPY(rbuf, file)) {
+            rbuf->buffers[file] = rabuf->scratch[file]; // ------------------------------------------------------- the next read_chunk() points it back into the mapping
+        } else {
+            rabuf->_u8s = rbuf->buffers[file]; // ----------------------------------------------------------------- the readbuf owns and frees its buffer, so trade it for scratch
+            rbuf->buffers[file] = rabuf->scratch[file];
+            rabuf->scratch[file] = rabuf->_u8s;
+            rabuf->scratch_size[file] = BUFFER_SIZE;
+        }
+        rbuf->chunk_size[file] = size;
     }
 }
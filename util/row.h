@@ -37,6 +37,33 @@ inlined void row_to_raw_malloc(row_t *row, raw_row_t *raw_row) {
     memcpy(raw_row->buffer, row->columns[0], raw_row->buffer_size);
 }
 
+// copy row into a single buffer of *capacity bytes at raw_row->header, growing it only when row does not fit. start with NULL and 0.
+inlined void row_to_raw_reuse(row_t *row, raw_row_t *raw_row, i32 *capacity) {
+    raw_row->header_size = sizeof(u16) + (row->max + 1) * sizeof(u16);
+    raw_row->buffer_size = 0;
+    for (i32 i = 0; i <= row->max; i++)
+        raw_row->buffer_size += row->sizes[i] + 1;
+    if (raw_row->header_size + raw_row->buffer_size > *capacity) {
+        *capacity = raw_row->header_size + raw_row->buffer_size;
+        REALLOC(raw_row->header, *capacity);
+    }
+    memcpy(raw_row->header, row->columns[0] - raw_row->header_size, raw_row->header_size + raw_row->buffer_size); // -- the header sits right before the columns
+    raw_row->buffer = raw_row->header + raw_row->header_size;
+}
+
+// parse the row laid out by dump() at the start of raw, like load_next() does from a readbuf, and return its size
+inlined i32 row_from_raw(u8 *raw, row_t *row) {
+    row->stop = 0;
+    row->max = FROM_UINT16(raw);
+    row->columns[0] = raw + sizeof(u16) * (row->max + 2);
+    for (i32 i = 0; i <= row->max; i++) {
+        row->sizes[i] = FROM_UINT16(raw + sizeof(u16) * (i + 1));
+        if (i < row->max)
+            row->columns[i + 1] = row->columns[i] + row->sizes[i] + 1;
+    }
+    return row->columns[row->max] + row->sizes[row->max] + 1 - raw;
+}
+
 inlined void raw_row_free(raw_row_t *raw_row) {
     free(raw_row->header);
     free(raw_row->buffer);
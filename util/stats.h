@@ -0,0 +1,102 @@
+#pragma once
+
+#include "util.h"
+#include "codec.h"
+
+//
+// chunk stats, also known as a zone map, are the number of rows in a
+// chunk and the min and max of their first column. they sit between
+// the chunk header and the rest of the chunk when the header has
+// CHUNK_STATS set:
+//
+// | i32:rows | u16:type | u16:min_size | u16:max_size | u8[]:min | u8[]:max |
+//
+// min and max are compared as type, which is never reversed, and are
+// each followed by a single null byte like any column. readers can
+// rule out a chunk from its stats alone, and skip it without
+// decompressing or parsing it, see read_peek().
+//
+
+#define NO_STATS -1
+#define STATS_HEADER_SIZE (sizeof(i32) + sizeof(u16) * 3)
+#define STATS_MAX_SIZE (STATS_HEADER_SIZE + (MAX_COLUMNS + 1) * 2)
+
+typedef struct chunk_stats_s {
+    i32 type; // ------------------------------ NO_STATS when the chunk has none
+    i32 rows;
+    u8 *min;
+    u16 min_size;
+    u8 *max;
+    u16 max_size;
+    u64 hash; // ------------------------------ folded into the chunk checksum
+} chunk_stats_t;
+
+// stats of reversed data are kept in the normal order, so they are usable by any reader of that type
+inlined i32 stats_type(i32 value_type) {
+    return value_type >= R_STR ? value_type - R_STR : value_type;
+}
+
+// walk the rows of a chunk, and write its stats to dst, which must hold STATS_MAX_SIZE bytes. returns their size.
+inlined i32 stats_write(u8 *dst, u8 *chunk, i32 size, i32 type) {
+    u8 *row = chunk;
+    u8 *key;
+    u8 *min = NULL;
+    u8 *max = NULL;
+    i32 rows = 0;
+    i32 columns;
+    u16 key_size;
+    u16 min_size = 0;
+    u16 max_size = 0;
+    while (row < chunk + size) {
+        columns = FROM_UINT16(row) + 1;
+        key_size = FROM_UINT16(row + sizeof(u16));
+        key = row + sizeof(u16) * (columns + 1);
+        ASSERT_SIZE(type, key_size);
+        if (!min || compare(type, key, min) < 0) {
+            min = key;
+            min_size = key_size;
+        }
+        if (!max || compare(type, key, max) > 0) {
+            max = key;
+            max_size = key_size;
+        }
+        for (i32 i = 0; i < columns; i++)
+            key += FROM_UINT16(row + sizeof(u16) * (i + 1)) + 1;
+        row = key; // ---------------------------------------------------------------------------------- past the last column is the next row
+        rows++;
+    }
+    u16 type_u16 = type;
+    memcpy(dst, &rows, sizeof(i32));
+    memcpy(dst + sizeof(i32), &type_u16, sizeof(u16));
+    memcpy(dst + sizeof(i32) + sizeof(u16), &min_size, sizeof(u16));
+    memcpy(dst + sizeof(i32) + sizeof(u16) * 2, &max_size, sizeof(u16));
+    dst += STATS_HEADER_SIZE;
+    memcpy(dst, min, min_size + 1);
+    memcpy(dst + min_size + 1, max, max_size + 1);
+    return STATS_HEADER_SIZE + min_size + max_size + 2;
+}
+
+// the size of the stats whose first STATS_HEADER_SIZE bytes are at src
+inlined i32 stats_length(u8 *src) {
+    return STATS_HEADER_SIZE + FROM_UINT16(src + sizeof(i32) + sizeof(u16)) + FROM_UINT16(src + sizeof(i32) + sizeof(u16) * 2) + 2;
+}
+
+// read stats from file into dst, which must hold STATS_MAX_SIZE bytes. returns their size.
+inlined i32 stats_read(u8 *dst, FILE *file) {
+    FREAD(dst, STATS_HEADER_SIZE, file);
+    i32 size = stats_length(dst);
+    FREAD(dst + STATS_HEADER_SIZE, size - STATS_HEADER_SIZE, file);
+    return size;
+}
+
+// point stats into the size bytes at src, which must outlive them
+inlined void stats_parse(chunk_stats_t *stats, u8 *src, i32 size) {
+    memcpy(&stats->rows, src, sizeof(i32));
+    stats->type = FROM_UINT16(src + sizeof(i32));
+    stats->min_size = FROM_UINT16(src + sizeof(i32) + sizeof(u16));
+    stats->max_size = FROM_UINT16(src + sizeof(i32) + sizeof(u16) * 2);
+    stats->min = src + STATS_HEADER_SIZE;
+    stats->max = stats->min + stats->min_size + 1;
+    stats->hash = XXH3_64bits(src, size);
+    ASSERT(stats->rows > 0 && stats->type < R_STR && stats->min[stats->min_size] == '\0' && stats->max[stats->max_size] == '\0', "fatal: bad chunk stats\n");
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include "util.h"
+#include "arena.h"
+#include "xxh3.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+//
+// an open addressing hash map from byte string keys to fixed size
+// values, laid out like a swiss table. every slot has a control byte,
+// which is SWISSMAP_EMPTY or the low 7 bits of the hash of its key, and
+// a probe compares 16 control bytes at once, so only slots whose tag
+// matches are looked at. the full hash is stored in the slot, so a tag
+// collision is settled without touching the key, and growing never
+// hashes a key again.
+//
+// capacity is a power of two, so probes mask instead of taking a
+// modulo, and the map grows at 7/8 full. probes step a group of 16
+// slots at a time from wherever the hash lands, and the first 16
+// control bytes are mirrored past the end so a group never wraps.
+//
+// keys are copied into an arena, and values start zeroed. there is no
+// delete. iterate with:
+//
+//   for (u64 i = 0; i < SWISSMAP_CAPACITY(map); i++)
+//       if (swissmap_full(&map, i))
+//           ... map.slots[i].key, map.slots[i].size, swissmap_value(&map, i)
+//
+
+#define SWISSMAP_EMPTY 0x80
+#define SWISSMAP_GROUP 16
+#define SWISSMAP_CAPACITY(map) ((map).mask + 1)
+
+typedef struct swissmap_slot_s {
+    u64 hash;
+    u8 *key;
+    i32 size;
+} swissmap_slot_t;
+
+typedef struct swissmap_s {
+    u64 mask;
+    u64 used;
+    u8 *ctrl; // --------------------------------- capacity control bytes, then the first SWISSMAP_GROUP again
+    swissmap_slot_t *slots;
+    u8 *values;
+    i32 value_size;
+    arena_t arena;
+} swissmap_t;
+
+inlined void swissmap_alloc(swissmap_t *map, u64 capacity) {
+    map->mask = capacity - 1;
+    MALLOC(map->ctrl, capacity + SWISSMAP_GROUP);
+    memset(map->ctrl, SWISSMAP_EMPTY, capacity + SWISSMAP_GROUP);
+    MALLOC(map->slots, sizeof(swissmap_slot_t) * capacity);
+    MALLOC(map->values, MAX(1, (u64)map->value_size * capacity)); // ----------------- sets have no values
+    memset(map->values, 0, (u64)map->value_size * capacity);
+}
+
+// capacity is rounded up to a power of two of at least one group
+swissmap_t swissmap_init(u64 capacity, i32 value_size) {
+    swissmap_t map;
+    u64 size = SWISSMAP_GROUP;
+    while (size < capacity)
+        size *= 2;
+    map.used = 0;
+    map.value_size = value_size;
+    map.arena = arena_init();
+    swissmap_alloc(&map, size);
+    return map;
+}
+
+void swissmap_free(swissmap_t *map) {
+    free(map->ctrl);
+    free(map->slots);
+    free(map->values);
+    arena_free(&map->arena);
+}
+
+// bytes held by the table and the keys
+inlined u64 swissmap_memory(swissmap_t *map) {
+    return SWISSMAP_CAPACITY(*map) * (1 + sizeof(swissmap_slot_t) + map->value_size) + (u64)map->arena.num_blocks * ARENA_BLOCK_SIZE;
+}
+
+// whether adding another key would double the table
+inlined bool swissmap_growing(swissmap_t *map) {
+    return (map->used + 1) * 8 > SWISSMAP_CAPACITY(*map) * 7;
+}
+
+inlined bool swissmap_full(swissmap_t *map, u64 index) {
+    return !(map->ctrl[index] & SWISSMAP_EMPTY);
+}
+
+inlined void *swissmap_value(swissmap_t *map, u64 index) {
+    return map->values + index * map->value_size;
+}
+
+inlined u8 swissmap_tag(u64 hash) {
+    return hash & 0x7f;
+}
+
+inlined void swissmap_set_ctrl(swissmap_t *map, u64 index, u8 tag) {
+    map->ctrl[index] = tag;
+    if (index < SWISSMAP_GROUP)
+        map->ctrl[SWISSMAP_CAPACITY(*map) + index] = tag;
+}
+
+// a bit for every control byte of the group at index that equals tag
+inlined u32 swissmap_match(swissmap_t *map, u64 index, u8 tag) {
+#if defined(__SSE2__)
+    __m128i group = _mm_loadu_si128((__m128i*)(map->ctrl + index));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(tag)));
+#else
+    u32 bits = 0;
+    for (i32 i = 0; i < SWISSMAP_GROUP; i++)
+        bits |= (u32)(map->ctrl[index + i] == tag) << i;
+    return bits;
+#endif
+}
+
+// the index of key, or of the empty slot where it would go
+inlined u64 swissmap_probe(swissmap_t *map, const u8 *key, i32 size, u64 hash) {
+    u8 tag = swissmap_tag(hash);
+    u64 index = (hash >> 7) & map->mask;
+    u64 slot;
+    u32 bits;
+    while (1) {
+        bits = swissmap_match(map, index, tag);
+        while (bits) {
+            slot = (index + __builtin_ctz(bits)) & map->mask;
+            if (map->slots[slot].hash == hash && map->slots[slot].size == size && memcmp(map->slots[slot].key, key, size) == 0)
+                return slot;
+            bits &= bits - 1;
+        }
+        bits = swissmap_match(map, index, SWISSMAP_EMPTY);
+        if (bits)
+            return (index + __builtin_ctz(bits)) & map->mask;
+        index = (index + SWISSMAP_GROUP) & map->mask;
+    }
+}
+
+// double the capacity, placing every slot again by its stored hash
+void swissmap_grow(swissmap_t *map) {
+    u8 *ctrl = map->ctrl;
+    swissmap_slot_t *slots = map->slots;
+    u8 *values = map->values;
+    u64 capacity = SWISSMAP_CAPACITY(*map);
+    u64 index;
+    u32 bits;
+    swissmap_alloc(map, capacity * 2);
+    for (u64 i = 0; i < capacity; i++) {
+        if (ctrl[i] & SWISSMAP_EMPTY)
+            continue;
+        index = (slots[i].hash >> 7) & map->mask;
+        while (!(bits = swissmap_match(map, index, SWISSMAP_EMPTY))) // ---------------------------------- every key is distinct, so only an empty slot is needed
+            index = (index + SWISSMAP_GROUP) & map->mask;
+        index = (index + __builtin_ctz(bits)) & map->mask;
+        swissmap_set_ctrl(map, index, ctrl[i]);
+        map->slots[index] = slots[i];
+        memcpy(swissmap_value(map, index), values + i * map->value_size, map->value_size);
+    }
+    free(ctrl);
+    free(slots);
+    free(values);
+}
+
+// the index of key, or -1 when it is missing
+inlined i64 swissmap_find(swissmap_t *map, const u8 *key, i32 size) {
+    u64 index = swissmap_probe(map, key, size, XXH3_64bits(key, size));
+    return swissmap_full(map, index) ? index : -1;
+}
+
+// swissmap_upsert() for a key whose hash is already known, like one from the slot of another map
+inlined u64 swissmap_upsert_hash(swissmap_t *map, const u8 *key, i32 size, u64 hash, bool *added) {
+    u64 index = swissmap_probe(map, key, size, hash);
+    *added = !swissmap_full(map, index);
+    if (*added) {
+        if (swissmap_growing(map)) {
+            swissmap_grow(map);
+            index = swissmap_probe(map, key, size, hash);
+        }
+        swissmap_set_ctrl(map, index, swissmap_tag(hash));
+        map->slots[index].hash = hash;
+        map->slots[index].size = size;
+        map->slots[index].key = arena_alloc(&map->arena, size);
+        memcpy(map->slots[index].key, key, size);
+        map->used++;
+    }
+    return index;
+}
+
+// the index of key, inserting it with a zeroed value when it is missing, and setting added if it was
+inlined u64 swissmap_upsert(swissmap_t *map, const u8 *key, i32 size, bool *added) {
+    return swissmap_upsert_hash(map, key, size, XXH3_64bits(key, size), added);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "util.h"
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#define THREAD_CREATE(thread, fn, arg)                                                  \
+    do {                                                                                \
+        ASSERT(0 == pthread_create(&thread, NULL, fn, arg), "fatal: pthread_create\n"); \
+    } while(0)
+
+#define THREAD_JOIN(thread)                                                     \
+    do {                                                                        \
+        ASSERT(0 == pthread_join(thread, NULL), "fatal: pthread_join\n");       \
+    } while(0)
+
+#define SEM_INIT(sem, value)                                            \
+    do {                                                                \
+        ASSERT(0 == sem_init(&sem, 0, value), "fatal: sem_init\n");     \
+    } while(0)
+
+#define SEM_WAIT(sem)                                                                   \
+    do {                                                                                \
+        while (0 != sem_wait(&sem))                                                     \
+            ASSERT(errno == EINTR, "fatal: sem_wait\n");                                \
+    } while(0)
+
+#define SEM_POST(sem)                                           \
+    do {                                                        \
+        ASSERT(0 == sem_post(&sem), "fatal: sem_post\n");       \
+    } while(0)
+
+#define MUTEX_LOCK(mutex)                                                       \
+    do {                                                                        \
+        ASSERT(0 == pthread_mutex_lock(&mutex), "fatal: pthread_mutex_lock\n"); \
+    } while(0)
+
+#define MUTEX_UNLOCK(mutex)                                                         \
+    do {                                                                            \
+        ASSERT(0 == pthread_mutex_unlock(&mutex), "fatal: pthread_mutex_unlock\n"); \
+    } while(0)
+
+#define COND_WAIT(cond, mutex)                                                          \
+    do {                                                                                \
+        ASSERT(0 == pthread_cond_wait(&cond, &mutex), "fatal: pthread_cond_wait\n");    \
+    } while(0)
+
+#define COND_BROADCAST(cond)                                                            \
+    do {                                                                                \
+        ASSERT(0 == pthread_cond_broadcast(&cond), "fatal: pthread_cond_broadcast\n");  \
+    } while(0)
@@ -41,9 +41,10 @@ typedef double   f64;
 #define fwrite_unlocked fwrite
 #endif
 
-i32 _i32;
-u16 _u16;
-u8 _u8;
+// scratch space for the macros below, thread local so they are safe to use from worker threads
+__thread i32 _i32;
+__thread u16 _u16;
+__thread u8 _u8;
 
 void _sigpipe_handler(int signum) {
     (void)signum;
@@ -63,7 +64,7 @@ void _sigpipe_handler(int signum) {
 // if you want to change it, you have to convert your data to bsv
 // again.
 #define BUFFER_SIZE 1024 * 1024 * 5
-#define BUFFER_SIZE_LZ4 BUFFER_SIZE + 1024 * 256
+#define BUFFER_SIZE_LZ4 BUFFER_SIZE + 1024 * 256 // room for the worst case of any codec
 #define LZ4_ACCELERATION 3
 
 #define ASSERT(cond, ...)                       \
@@ -181,6 +182,7 @@ void _sigpipe_handler(int signum) {
                sizeof(u16) == 2,                                                            \
                "fatal: invariants are varying!\n");                                         \
         ASSERT(BUFFER_SIZE < INT_MAX, "fatal: buffer size must be less than INT_MAX\n");    \
+        ASSERT(BUFFER_SIZE < 1 << 24, "fatal: buffer size must be less than 1<<24\n");      \
     } while (0)
 
 #define SETUP()                                 \
@@ -208,6 +210,36 @@ int isdigits_ordot(const char *s) {
     return 1;
 }
 
+// parse a size in bytes like 1048576, 512K, 64M or 4G, returning -1 if s is not one
+i64 parse_size(const char *s) {
+    char *end;
+    i64 size;
+    if (s == NULL || !isdigit(*s))
+        return -1;
+    size = strtoll(s, &end, 10);
+    switch (*end) {
+        case '\0': return size;
+        case 'K': case 'k': size <<= 10; break;
+        case 'M': case 'm': size <<= 20; break;
+        case 'G': case 'g': size <<= 30; break;
+        default: return -1;
+    }
+    return end[1] == '\0' ? size : -1;
+}
+
+// create a temp file in tmpdir named after prefix, open for reading and writing. it is unlinked right away, so it is gone when the process is, however it exits.
+FILE *temp_open(const char *tmpdir, const char *prefix) {
+    char path[1024];
+    FILE *file;
+    SNPRINTF(path, sizeof(path), "%s/%s.XXXXXX", tmpdir, prefix);
+    int fd = mkstemp(path);
+    ASSERT(fd >= 0, "fatal: failed to create temp file in: %s\n", tmpdir);
+    ASSERT(0 == unlink(path), "fatal: failed to unlink: %s\n", path);
+    file = fdopen(fd, "w+b");
+    ASSERT(file, "fatal: failed to open: %s\n", path);
+    return file;
+}
+
 enum value_type {
     // normal
     STR,
@@ -278,6 +310,35 @@ inlined int compare(const i32 value_type, const void *v1, const void *v2) {
     }
 }
 
+typedef int (*compare_fn_t)(const void *, const void *);
+
+// the compare_* function for value_type, for callers like heap.h that take a function pointer
+inlined compare_fn_t compare_fn(const i32 value_type) {
+    switch (value_type) {
+        // normal
+        case STR: return compare_str;
+        case I64: return compare_i64;
+        case I32: return compare_i32;
+        case I16: return compare_i16;
+        case U64: return compare_u64;
+        case U32: return compare_u32;
+        case U16: return compare_u16;
+        case F64: return compare_f64;
+        case F32: return compare_f32;
+        // reverse
+        case R_STR: return compare_r_str;
+        case R_I64: return compare_r_i64;
+        case R_I32: return compare_r_i32;
+        case R_I16: return compare_r_i16;
+        case R_U64: return compare_r_u64;
+        case R_U32: return compare_r_u32;
+        case R_U16: return compare_r_u16;
+        case R_F64: return compare_r_f64;
+        case R_F32: return compare_r_f32;
+        default: ASSERT(0, "fatal: unknown sort type\n");
+    }
+}
+
 #define ASSERT_SIZE(value_type, size)                                                           \
     switch (value_type) {                                                                       \
         /* normal */                                                                            \
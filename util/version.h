@@ -0,0 +1,5 @@
+#define VERSION_GIT_HASH "git:      c7480e1d438a6ecb1f9217f6d8954e871522ccf1"
+#define VERSION_DATE     "date:     2026-10-17T06:45:34Z"
+#define VERSION_COMPILER "compiler: gcc (Debian 12.2.0-14+deb12u1) 12.2.0"
+#define VERSION_ARCH     "arch:     znver3"
+#define VERSION_DEVEL    "devel:    true"
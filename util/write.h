@@ -1,31 +1,51 @@
 #pragma once
 
 #include "util.h"
-#include "lz4.h"
+#include "thread.h"
+#include "codec.h"
+#include "stats.h"
+#include <sys/stat.h>
+
+typedef struct writer_s writer_t;
 
 typedef struct writebuf_s {
     // private
     FILE **files;
+    i32 num_files;
     u8 **buffer;
     i32 *offset;
-    bool lz4;
-    u8 *lz4_buf;
-    i32 lz4_size;
+    i32 codec;
+    u8 *codec_buf;
+    bool checksum; // ---------------------------- append an xxh3 of each chunk for readers to verify
+    i32 stats; // -------------------------------- type to record the stats of each chunk's first column as, or NO_STATS
+    struct writebuf_s *index; // ----------------- sidecar with a row per chunk, see wbuf_index()
+    i64 position; // ----------------------------- bytes written so far, only tracked with an index
+    writer_t *writer;
+    pthread_mutex_t *locks; // ------------------- per file locks, when the files are shared with other writebufs, see wbuf_shared()
 } writebuf_t;
 
-writebuf_t wbuf_init(FILE **files, i32 num_files, bool lz4) {
+writebuf_t wbuf_init(FILE **files, i32 num_files, i32 codec) {
     writebuf_t *buf;
     MALLOC(buf, sizeof(writebuf_t));
     buf->files = files;
+    buf->num_files = num_files;
+    buf->writer = NULL;
+    buf->locks = NULL;
+    buf->checksum = false;
+    buf->stats = NO_STATS;
+    buf->index = NULL;
+    buf->position = 0;
     MALLOC(buf->buffer, sizeof(u8*) * num_files);
     MALLOC(buf->offset, sizeof(i32) * num_files);
     for (i32 i = 0; i < num_files; i++) {
         buf->offset[i] = 0;
         MALLOC(buf->buffer[i], BUFFER_SIZE);
     }
-    buf->lz4 = lz4;
-    if (lz4)
-        MALLOC(buf->lz4_buf, BUFFER_SIZE_LZ4);
+    buf->codec = codec;
+    if (CODEC_TYPE(codec) != CODEC_NONE) {
+        codec_supported(CODEC_TYPE(codec));
+        MALLOC(buf->codec_buf, BUFFER_SIZE_LZ4);
+    }
     return *buf;
 }
 
@@ -34,22 +54,266 @@ inlined void write_bytes(writebuf_t *buf, u8 *bytes, i32 size, i32 file) {
         buf->offset[file] += size;
 }
 
-#define COMPRESS(buf)                                                                                           \
-    LZ4_compress_fast(buf->buffer[file], buf->lz4_buf, buf->offset[file], BUFFER_SIZE_LZ4, LZ4_ACCELERATION)
+// write a chunk and return the number of bytes it took on disk
+inlined i64 write_chunk(FILE *file, u8 *buffer, i32 size, i32 codec, u8 *codec_buf, bool checksum, i32 stats) {
+    static __thread u8 *stats_buf = NULL;
+    i32 header = CHUNK_HEADER(size, codec) | (checksum ? CHUNK_CHECKSUM : 0) | (stats != NO_STATS ? CHUNK_STATS : 0);
+    i32 stats_size = 0;
+    u64 stats_hash = 0;
+    u64 hash;
+    FWRITE(&header, sizeof(i32), file); // --------------------------------------------------------------- write chunk size tagged with its codec and flags
+    if (stats != NO_STATS) {
+        if (!stats_buf)
+            MALLOC(stats_buf, STATS_MAX_SIZE);
+        stats_size = stats_write(stats_buf, buffer, size, stats);
+        stats_hash = XXH3_64bits(stats_buf, stats_size);
+        FWRITE(stats_buf, stats_size, file); // ---------------------------------------------------------- write chunk stats
+    }
+    if (CODEC_TYPE(codec) != CODEC_NONE) {
+        size = codec_compress(codec, buffer, codec_buf, size); // ----------------------------------------- compress chunk
+        buffer = codec_buf;
+        FWRITE(&size, sizeof(i32), file); // ------------------------------------------------------------- write compressed size
+    }
+    FWRITE(buffer, size, file); // ----------------------------------------------------------------------- write chunk
+    if (checksum) {
+        hash = chunk_checksum(header, stats_hash, buffer, size);
+        FWRITE(&hash, sizeof(u64), file); // ------------------------------------------------------------- write checksum trailer
+    }
+    return sizeof(i32) + stats_size + (CODEC_TYPE(codec) != CODEC_NONE ? sizeof(i32) : 0) + size + (checksum ? sizeof(u64) : 0);
+}
+
+//
+// an index is a bsv file with a row per chunk of its data file:
+//
+// | i64:offset | first key | last key |
+//
+// where offset is the byte offset of the chunk in the data file, and
+// the keys are the first column of the first and last rows of the
+// chunk. for sorted data it lets readers binary search for the chunk
+// holding a value instead of scanning to it, see index.h.
+//
+writebuf_t *index_open(char *path) {
+    FILE **files;
+    writebuf_t *index;
+    MALLOC(files, sizeof(FILE*));
+    FOPEN(files[0], path, "wb");
+    MALLOC(index, sizeof(writebuf_t));
+    *index = wbuf_init(files, 1, CODEC_NONE);
+    return index;
+}
+
+// write an index of buf to path as its chunks are written
+void wbuf_index(writebuf_t *buf, char *path) {
+    struct stat st;
+    i32 fd = fileno(buf->files[0]);
+    ASSERT(buf->num_files == 1, "fatal: only a single output can be indexed\n");
+    ASSERT(0 == fstat(fd, &st), "fatal: failed to stat output\n");
+    if (S_ISREG(st.st_mode)) { // ----------------------------------------------------------------------- offsets count from the start of the file, not of this output
+        if (fcntl(fd, F_GETFL) & O_APPEND)
+            buf->position = st.st_size; // -------------------------------------------------------------- ftello() is 0 until the first write when appending
+        else
+            ASSERT(0 == ftello(buf->files[0]), "fatal: cannot index output that does not start at offset 0\n");
+    }
+    buf->index = index_open(path);
+}
+
+// share the files with other writebufs on other threads, each writing whole chunks under the lock of the file. locks must be initialized, one per file.
+void wbuf_shared(writebuf_t *buf, pthread_mutex_t *locks) {
+    ASSERT(!buf->index, "fatal: an indexed output cannot be shared\n");
+    buf->locks = locks;
+}
+
+// record the stats of each chunk, comparing first columns as value_type
+void wbuf_stats(writebuf_t *buf, i32 value_type) {
+    buf->stats = stats_type(value_type);
+}
+
+inlined void index_bytes(writebuf_t *index, u8 *bytes, i32 size) {
+    memcpy(index->buffer[0] + index->offset[0], bytes, size);
+    index->offset[0] += size;
+}
+
+// append the index row for a chunk about to be written at position
+inlined void index_chunk(writebuf_t *index, i64 position, u8 *chunk, i32 size) {
+    u8 *row = chunk;
+    u8 *last = chunk;
+    while (row < chunk + size) { // --------------------------------------------------------------------- walk the rows to find the last one
+        last = row;
+        i32 max = FROM_UINT16(row);
+        row += sizeof(u16) * (max + 2);
+        for (i32 i = 0; i <= max; i++)
+            row += FROM_UINT16(last + sizeof(u16) * (i + 1)) + 1;
+    }
+    u16 first_size = FROM_UINT16(chunk + sizeof(u16));
+    u16 last_size = FROM_UINT16(last + sizeof(u16));
+    u8 *first_key = chunk + sizeof(u16) * (FROM_UINT16(chunk) + 2);
+    u8 *last_key = last + sizeof(u16) * (FROM_UINT16(last) + 2);
+    i32 row_size = sizeof(u16) * 4 + sizeof(i64) + first_size + last_size + 3;
+    if (row_size > BUFFER_SIZE - index->offset[0]) {
+        write_chunk(index->files[0], index->buffer[0], index->offset[0], CODEC_NONE, NULL, false, NO_STATS);
+        index->offset[0] = 0;
+    }
+    index_bytes(index, TO_UINT16(2), sizeof(u16)); // ---------------------------------------------------- max
+    index_bytes(index, TO_UINT16(sizeof(i64)), sizeof(u16)); // ------------------------------------------ sizes
+    index_bytes(index, TO_UINT16(first_size), sizeof(u16));
+    index_bytes(index, TO_UINT16(last_size), sizeof(u16));
+    index_bytes(index, (u8*)&position, sizeof(i64)); // ------------------------------------------------ columns, each followed by \0
+    index_bytes(index, "\0", 1);
+    index_bytes(index, first_key, first_size);
+    index_bytes(index, "\0", 1);
+    index_bytes(index, last_key, last_size);
+    index_bytes(index, "\0", 1);
+}
+
+// write out the rest of the index, once the data file is complete
+void index_flush(writebuf_t *index) {
+    if (index->offset[0]) {
+        write_chunk(index->files[0], index->buffer[0], index->offset[0], CODEC_NONE, NULL, false, NO_STATS);
+        index->offset[0] = 0;
+        ASSERT(fflush(index->files[0]) == 0, "fatal: failed to flush index\n");
+    }
+}
+
+//
+// the async writer hands full buffers to worker threads which compress
+// and write them, swapping in a free buffer from a bounded pool so the
+// caller can keep filling. chunks for the same file are numbered as they
+// are handed off, and a worker waits for its turn before writing, so the
+// order of chunks within each file is preserved.
+//
+typedef struct writer_job_s {
+    u8 *buffer;
+    i32 size;
+    i32 file;
+    u64 seq;
+} writer_job_t;
+
+struct writer_s {
+    FILE **files;
+    i32 codec;
+    bool checksum;
+    i32 stats;
+    writebuf_t *index;
+    i64 position; // ----------------------------- only touched by the worker whose turn it is, like the file itself
+    i32 num_workers;
+    pthread_t *workers;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    u8 **pool; // -------------------------------- free buffers
+    i32 pool_size;
+    writer_job_t *jobs; // ----------------------- fifo of pending jobs, never larger than the pool
+    i32 jobs_capacity;
+    i32 jobs_head;
+    i32 jobs_size;
+    u64 *submitted; // --------------------------- per file count of chunks handed off
+    u64 *written; // ----------------------------- per file count of chunks written
+};
+
+void *writer_worker(void *arg) {
+    writer_t *w = arg;
+    writer_job_t job;
+    u8 *codec_buf = NULL;
+    if (CODEC_TYPE(w->codec) != CODEC_NONE)
+        MALLOC(codec_buf, BUFFER_SIZE_LZ4);
+    while (1) {
+        MUTEX_LOCK(w->lock);
+        while (w->jobs_size == 0) // ----------------------------------------------------------------- wait for work
+            COND_WAIT(w->cond, w->lock);
+        job = w->jobs[w->jobs_head];
+        w->jobs_head = (w->jobs_head + 1) % w->jobs_capacity;
+        w->jobs_size--;
+        while (w->written[job.file] != job.seq) // ------------------------------------------------- wait for earlier chunks of this file
+            COND_WAIT(w->cond, w->lock);
+        MUTEX_UNLOCK(w->lock);
+        if (w->index)
+            index_chunk(w->index, w->position, job.buffer, job.size);
+        w->position += write_chunk(w->files[job.file], job.buffer, job.size, w->codec, codec_buf, w->checksum, w->stats); // - compress and write outside the lock
+        MUTEX_LOCK(w->lock);
+        w->written[job.file]++;
+        w->pool[w->pool_size++] = job.buffer; // ---------------------------------------------------- recycle the buffer
+        COND_BROADCAST(w->cond);
+        MUTEX_UNLOCK(w->lock);
+    }
+    return NULL;
+}
+
+// compress and write on num_workers background threads with num_workers * 2 spare buffers. set options like checksum, stats and index first.
+void wbuf_async(writebuf_t *buf, i32 num_workers) {
+    ASSERT(num_workers > 0, "fatal: number of writers must be positive, got: %d\n", num_workers);
+    writer_t *w;
+    MALLOC(w, sizeof(writer_t));
+    w->files = buf->files;
+    w->codec = buf->codec;
+    w->checksum = buf->checksum;
+    w->stats = buf->stats;
+    w->index = buf->index;
+    w->position = buf->position;
+    w->num_workers = num_workers;
+    ASSERT(0 == pthread_mutex_init(&w->lock, NULL), "fatal: pthread_mutex_init\n");
+    ASSERT(0 == pthread_cond_init(&w->cond, NULL), "fatal: pthread_cond_init\n");
+    w->pool_size = num_workers * 2;
+    w->jobs_capacity = w->pool_size;
+    w->jobs_head = 0;
+    w->jobs_size = 0;
+    MALLOC(w->pool, sizeof(u8*) * w->pool_size);
+    for (i32 i = 0; i < w->pool_size; i++)
+        MALLOC(w->pool[i], BUFFER_SIZE);
+    MALLOC(w->jobs, sizeof(writer_job_t) * w->jobs_capacity);
+    MALLOC(w->submitted, sizeof(u64) * buf->num_files);
+    MALLOC(w->written, sizeof(u64) * buf->num_files);
+    for (i32 i = 0; i < buf->num_files; i++) {
+        w->submitted[i] = 0;
+        w->written[i] = 0;
+    }
+    MALLOC(w->workers, sizeof(pthread_t) * num_workers);
+    for (i32 i = 0; i < num_workers; i++)
+        THREAD_CREATE(w->workers[i], writer_worker, w);
+    buf->writer = w;
+}
+
+inlined void writer_submit(writebuf_t *buf, i32 file) {
+    writer_t *w = buf->writer;
+    MUTEX_LOCK(w->lock);
+    while (w->pool_size == 0) // ---------------------------------------------------------------------- backpressure when every spare buffer is in flight
+        COND_WAIT(w->cond, w->lock);
+    writer_job_t *job = &w->jobs[(w->jobs_head + w->jobs_size++) % w->jobs_capacity];
+    job->buffer = buf->buffer[file];
+    job->size = buf->offset[file];
+    job->file = file;
+    job->seq = w->submitted[file]++;
+    buf->buffer[file] = w->pool[--w->pool_size];
+    COND_BROADCAST(w->cond);
+    MUTEX_UNLOCK(w->lock);
+}
 
 inlined void write_flush(writebuf_t *buf, i32 file) {
     if (buf->offset[file]) { // ------------------------------------------------ flush with an empty buffer is a nop
-        FWRITE(&buf->offset[file], sizeof(i32), buf->files[file]); // ---------- write chunk size
-        if (buf->lz4) {
-            i32 lz4_size = COMPRESS(buf); // ----------------------------------- compress chunk
-            FWRITE(&lz4_size, sizeof(i32), buf->files[file]);          // ------ write compressed size
-            FWRITE(buf->lz4_buf, lz4_size, buf->files[file]);          // ------ write compressed chunk
-        } else
-            FWRITE(buf->buffer[file], buf->offset[file], buf->files[file]); // - write chunk
+        if (buf->writer)
+            writer_submit(buf, file); // ------------------------------------- hand the chunk to the async writer
+        else {
+            if (buf->index)
+                index_chunk(buf->index, buf->position, buf->buffer[file], buf->offset[file]);
+            if (buf->locks)
+                MUTEX_LOCK(buf->locks[file]);
+            buf->position += write_chunk(buf->files[file], buf->buffer[file], buf->offset[file], buf->codec, buf->codec_buf, buf->checksum, buf->stats);
+            if (buf->locks)
+                MUTEX_UNLOCK(buf->locks[file]);
+        }
         buf->offset[file] = 0; // ---------------------------------------------- reset the buffer to prepare for the next write
     }
 }
 
+// block until every chunk handed off for file has been written
+inlined void write_wait(writebuf_t *buf, i32 file) {
+    writer_t *w = buf->writer;
+    if (w) {
+        MUTEX_LOCK(w->lock);
+        while (w->written[file] != w->submitted[file])
+            COND_WAIT(w->cond, w->lock);
+        MUTEX_UNLOCK(w->lock);
+    }
+}
+
 inlined void write_start(writebuf_t *buf, i32 size, i32 file) {
   ASSERT(size <= BUFFER_SIZE, "fatal: cant write larger than BUFFER_SIZE\n");
   if (size > BUFFER_SIZE - buf->offset[file])